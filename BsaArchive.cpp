@@ -0,0 +1,219 @@
+#include "BsaArchive.h"
+
+#include <QDataStream>
+#include <QList>
+#include <QVector>
+#include <QtEndian>
+
+static const quint32 BSA_VERSION = 0x100;
+static const int BSA_HEADER_SIZE = 12;
+
+BsaArchive::BsaArchive(const QString& archivePath)
+	: file(archivePath)
+{
+	directory = 0;
+	count = 0;
+	records = 0;
+	nameOffsets = 0;
+	names = 0;
+	namesSize = 0;
+	dataStart = 0;
+}
+
+BsaArchive::~BsaArchive()
+{
+	close();
+}
+
+bool BsaArchive::open()
+{
+	close();
+
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	uchar header[BSA_HEADER_SIZE];
+	if (file.read(reinterpret_cast<char*>(header), BSA_HEADER_SIZE) != BSA_HEADER_SIZE)
+	{
+		close();
+		return false;
+	}
+
+	quint32 version = qFromLittleEndian<quint32>(header);
+	quint32 hashOffset = qFromLittleEndian<quint32>(header + 4);
+	quint32 fileCount = qFromLittleEndian<quint32>(header + 8);
+	if (version != BSA_VERSION)
+	{
+		close();
+		return false;
+	}
+
+	// The records, name offsets and names all sit between the header and the hash table.
+	quint64 namesStart = BSA_HEADER_SIZE + quint64(fileCount) * 12;
+	quint64 directoryEnd = BSA_HEADER_SIZE + quint64(hashOffset);
+	if (namesStart > directoryEnd || directoryEnd + quint64(fileCount) * 8 > quint64(file.size()))
+	{
+		close();
+		return false;
+	}
+
+	directory = file.map(0, directoryEnd);
+	if (!directory)
+	{
+		close();
+		return false;
+	}
+
+	count = fileCount;
+	records = directory + BSA_HEADER_SIZE;
+	nameOffsets = records + quint64(count) * 8;
+	names = directory + namesStart;
+	namesSize = quint32(directoryEnd - namesStart);
+	dataStart = qint64(directoryEnd + quint64(count) * 8);
+	return true;
+}
+
+void BsaArchive::close()
+{
+	if (directory)
+		file.unmap(directory);
+	file.close();
+
+	directory = 0;
+	count = 0;
+	records = 0;
+	nameOffsets = 0;
+	names = 0;
+	namesSize = 0;
+	dataStart = 0;
+}
+
+bool BsaArchive::isOpen() const
+{
+	return directory != 0;
+}
+
+int BsaArchive::fileCount() const
+{
+	return int(count);
+}
+
+QString BsaArchive::fileName(int index) const
+{
+	if (index < 0 || quint32(index) >= count)
+		return QString();
+
+	quint32 offset = qFromLittleEndian<quint32>(nameOffsets + quint64(index) * 4);
+	if (offset >= namesSize)
+		return QString();
+
+	const char* name = reinterpret_cast<const char*>(names + offset);
+	QString result = QString::fromLatin1(name, int(qstrnlen(name, namesSize - offset)));
+	result.replace('\\', '/');
+	return result;
+}
+
+quint32 BsaArchive::fileSize(int index) const
+{
+	if (index < 0 || quint32(index) >= count)
+		return 0;
+
+	return qFromLittleEndian<quint32>(records + quint64(index) * 8);
+}
+
+qint64 BsaArchive::fileOffset(int index) const
+{
+	if (index < 0 || quint32(index) >= count)
+		return 0;
+
+	return dataStart + qFromLittleEndian<quint32>(records + quint64(index) * 8 + 4);
+}
+
+QStringList BsaArchive::fileNames() const
+{
+	QStringList result;
+	result.reserve(int(count));
+	for (int index = 0; index < int(count); index++)
+		result.push_back(fileName(index));
+	return result;
+}
+
+//! Writes a new archive. Entries are stored in key order; OpenMW doesn't need them sorted by hash.
+bool BsaArchive::create(const QString& archivePath, const QMap<QString, QByteArray>& files)
+{
+	QFile output(archivePath);
+	if (!output.open(QIODevice::WriteOnly))
+		return false;
+
+	QList<QByteArray> fileNameList;
+	QVector<quint32> nameOffsetList;
+	QByteArray nameTable;
+	foreach (const QString& path, files.keys())
+	{
+		QByteArray name = path.toLower().toLatin1();
+		name.replace('/', '\\');
+
+		nameOffsetList.push_back(quint32(nameTable.size()));
+		nameTable.append(name);
+		nameTable.append('\0');
+		fileNameList.push_back(name);
+	}
+
+	quint32 fileCount = quint32(files.size());
+
+	QDataStream stream(&output);
+	stream.setByteOrder(QDataStream::LittleEndian);
+	stream << BSA_VERSION << quint32(fileCount * 12 + nameTable.size()) << fileCount;
+
+	quint32 offset = 0;
+	foreach (const QByteArray& data, files)
+	{
+		stream << quint32(data.size()) << offset;
+		offset += quint32(data.size());
+	}
+
+	foreach (quint32 nameOffset, nameOffsetList)
+		stream << nameOffset;
+	stream.writeRawData(nameTable.constData(), nameTable.size());
+
+	foreach (const QByteArray& name, fileNameList)
+	{
+		quint64 hash = hashName(name);
+		stream << quint32(hash & 0xffffffff) << quint32(hash >> 32);
+	}
+
+	foreach (const QByteArray& data, files)
+		stream.writeRawData(data.constData(), data.size());
+
+	return stream.status() == QDataStream::Ok;
+}
+
+//! The TES3 name hash. The low word comes from the first half of the name, the high word from the rest.
+quint64 BsaArchive::hashName(const QByteArray& name)
+{
+	int length = name.size();
+	int half = length >> 1;
+
+	quint32 low = 0;
+	unsigned int shift = 0;
+	for (int i = 0; i < half; i++)
+	{
+		low ^= quint32(uchar(name[i])) << (shift & 0x1f);
+		shift += 8;
+	}
+
+	quint32 high = 0;
+	shift = 0;
+	for (int i = half; i < length; i++)
+	{
+		quint32 temp = quint32(uchar(name[i])) << (shift & 0x1f);
+		high ^= temp;
+
+		unsigned int rotation = temp & 0x1f;
+		if (rotation)
+			high = (high << (32 - rotation)) | (high >> rotation);
+		shift += 8;
+	}
+
+	return (quint64(high) << 32) | low;
+}
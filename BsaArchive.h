@@ -0,0 +1,45 @@
+#ifndef BSAARCHIVE_H
+#define BSAARCHIVE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+
+/**
+ * Reads the directory of a Morrowind (TES3) BSA archive without extracting anything.
+ * Only the header, file records and name table are memory-mapped; file data is never touched.
+ */
+class BsaArchive
+{
+public:
+	BsaArchive(const QString& archivePath);
+	~BsaArchive();
+
+	bool open();
+	void close();
+	bool isOpen() const;
+
+	int fileCount() const;
+	QString fileName(int index) const;
+	quint32 fileSize(int index) const;
+	qint64 fileOffset(int index) const;
+	QStringList fileNames() const;
+
+	static bool create(const QString& archivePath, const QMap<QString, QByteArray>& files);
+	static quint64 hashName(const QByteArray& name);
+
+private:
+	QFile file;
+	uchar* directory;
+
+	quint32 count;
+	const uchar* records;
+	const uchar* nameOffsets;
+	const uchar* names;
+	quint32 namesSize;
+	qint64 dataStart;
+};
+
+#endif // BSAARCHIVE_H
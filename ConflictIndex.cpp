@@ -0,0 +1,705 @@
+#include "ConflictIndex.h"
+
+#include <QRegExp>
+#include <QSet>
+
+#include <algorithm>
+
+// Orders path IDs by their normalized paths.
+struct PathLess
+{
+	explicit PathLess(const QVector<VfsPath>& pathList) : paths(pathList) {}
+
+	bool operator()(int pathId, int otherPathId) const
+	{
+		return paths[pathId].toString() < paths[otherPathId].toString();
+	}
+
+	const QVector<VfsPath>& paths;
+};
+
+ConflictIndex::ConflictIndex()
+{
+	ignoreIdentical = false;
+}
+
+void ConflictIndex::addFolder(const QString& folder, const QStringList& relativePaths)
+{
+	if (folderIds.contains(folder))
+		removeFolder(folder);
+
+	int folderId;
+	if (freeFolderIds.isEmpty())
+	{
+		folderId = folders.size();
+		folders.push_back(folder);
+		folderPaths.push_back(QVector<int>());
+		folderOverlaps.push_back(QHash<int, int>());
+		identicalOverlaps.push_back(QHash<int, int>());
+		extraSpellings.push_back(QHash<int, int>());
+		folderRanks.push_back(-1);
+		filesWon.push_back(0);
+		filesLost.push_back(0);
+		countsDirty.push_back(true);
+	}
+	else
+	{
+		folderId = freeFolderIds.takeLast();
+		folders[folderId] = folder;
+	}
+	folderIds.insert(folder, folderId);
+	folderRanks[folderId] = loadOrder.value(folder, -1);
+	countsDirty[folderId] = true;
+
+	QVector<int>& ownedPaths = folderPaths[folderId];
+	ownedPaths.reserve(relativePaths.size());
+	foreach (const QString& relativePath, relativePaths)
+	{
+		int pathId = internPath(relativePath);
+		FolderIdList& pathProviders = providers[pathId];
+
+		// Names that only differ by case fold into the same path.
+		if (!pathProviders.isEmpty() && pathProviders[pathProviders.size() - 1] == folderId)
+		{
+			extraSpellings[folderId][pathId]++;
+			continue;
+		}
+
+		for (int i = 0; i < pathProviders.size(); i++)
+			changeOverlap(folderId, pathProviders[i], 1);
+		pathProviders.append(folderId);
+		providerHashes[pathId].append(0);
+		ownedPaths.push_back(pathId);
+		updateWinner(pathId);
+	}
+}
+
+void ConflictIndex::removeFolder(const QString& folder)
+{
+	int folderId = folderIds.value(folder, -1);
+	if (folderId < 0)
+		return;
+
+	foreach (int pathId, folderPaths[folderId])
+	{
+		FolderIdList& pathProviders = providers[pathId];
+		for (int i = 0; i < pathProviders.size(); i++)
+		{
+			if (pathProviders[i] == folderId)
+			{
+				removeProvider(pathId, i);
+				break;
+			}
+		}
+
+		for (int i = 0; i < pathProviders.size(); i++)
+			changeOverlap(folderId, pathProviders[i], -1);
+
+		if (pathProviders.isEmpty())
+			releasePath(pathId);
+		else
+			updateWinner(pathId);
+	}
+
+	folderIds.remove(folder);
+	folders[folderId] = QString();
+	folderPaths[folderId] = QVector<int>();
+	folderOverlaps[folderId].clear();
+	identicalOverlaps[folderId].clear();
+	extraSpellings[folderId].clear();
+	folderRanks[folderId] = -1;
+	freeFolderIds.push_back(folderId);
+}
+
+void ConflictIndex::addPaths(const QString& folder, const QStringList& relativePaths)
+{
+	int folderId = folderIds.value(folder, -1);
+	if (folderId < 0)
+	{
+		addFolder(folder, relativePaths);
+		return;
+	}
+
+	foreach (const QString& relativePath, relativePaths)
+	{
+		int pathId = internPath(relativePath);
+		FolderIdList& pathProviders = providers[pathId];
+		if (std::find(pathProviders.constBegin(), pathProviders.constEnd(), folderId) != pathProviders.constEnd())
+		{
+			extraSpellings[folderId][pathId]++;
+			continue;
+		}
+
+		for (int i = 0; i < pathProviders.size(); i++)
+			changeOverlap(folderId, pathProviders[i], 1);
+		pathProviders.append(folderId);
+		providerHashes[pathId].append(0);
+		folderPaths[folderId].push_back(pathId);
+		updateWinner(pathId);
+	}
+}
+
+void ConflictIndex::removePaths(const QString& folder, const QStringList& relativePaths)
+{
+	int folderId = folderIds.value(folder, -1);
+	if (folderId < 0)
+		return;
+
+	QSet<int> removedPaths;
+	foreach (const QString& relativePath, relativePaths)
+	{
+		int pathId = pathIds.value(VfsPath(relativePath), -1);
+		if (pathId < 0)
+			continue;
+
+		FolderIdList& pathProviders = providers[pathId];
+		int index = std::find(pathProviders.constBegin(), pathProviders.constEnd(), folderId) - pathProviders.constBegin();
+		if (index == pathProviders.size())
+			continue;
+
+		// Another spelling of the same name is still there, so the folder still provides it.
+		QHash<int, int>& spellings = extraSpellings[folderId];
+		QHash<int, int>::iterator spelling = spellings.find(pathId);
+		if (spelling != spellings.end())
+		{
+			if (--spelling.value() == 0)
+				spellings.erase(spelling);
+			continue;
+		}
+
+		removeProvider(pathId, index);
+		for (int i = 0; i < pathProviders.size(); i++)
+			changeOverlap(folderId, pathProviders[i], -1);
+
+		removedPaths.insert(pathId);
+		if (pathProviders.isEmpty())
+			releasePath(pathId);
+		else
+			updateWinner(pathId);
+	}
+
+	// Drop everything from the folder's own list in a single pass.
+	if (!removedPaths.isEmpty())
+	{
+		QVector<int> remainingPaths;
+		remainingPaths.reserve(folderPaths[folderId].size() - removedPaths.size());
+		foreach (int pathId, folderPaths[folderId])
+		{
+			if (!removedPaths.contains(pathId))
+				remainingPaths.push_back(pathId);
+		}
+		folderPaths[folderId] = remainingPaths;
+		countsDirty[folderId] = true;
+	}
+}
+
+bool ConflictIndex::containsFolder(const QString& folder) const
+{
+	return folderIds.contains(folder);
+}
+
+int ConflictIndex::getFolderId(const QString& folder) const
+{
+	return folderIds.value(folder, -1);
+}
+
+QString ConflictIndex::getFolder(int folderId) const
+{
+	return folders.value(folderId);
+}
+
+const QVector<int>& ConflictIndex::getFolderPaths(int folderId) const
+{
+	static const QVector<int> empty;
+	if (folderId < 0 || folderId >= folderPaths.size())
+		return empty;
+	return folderPaths[folderId];
+}
+
+int ConflictIndex::folderCount() const
+{
+	return folderIds.size();
+}
+
+const QHash<int, int>& ConflictIndex::getOverlaps(int folderId) const
+{
+	static const QHash<int, int> empty;
+	if (folderId < 0 || folderId >= folderOverlaps.size())
+		return empty;
+	return folderOverlaps[folderId];
+}
+
+int ConflictIndex::getOverlapCount(int folderId, int otherFolderId) const
+{
+	return getOverlaps(folderId).value(otherFolderId, 0);
+}
+
+void ConflictIndex::setLoadOrder(const QStringList& order)
+{
+	loadOrder.clear();
+	for (int rank = 0; rank < order.size(); rank++)
+		loadOrder.insert(order[rank], rank);
+
+	QVector<int> previousRanks = folderRanks;
+	for (QHash<QString, int>::const_iterator it = folderIds.constBegin(); it != folderIds.constEnd(); ++it)
+		folderRanks[it.value()] = loadOrder.value(it.key(), -1);
+
+	// Only folders that were toggled, or moved past a folder they share paths with, can change winners.
+	// Everything else just shifted along with its neighbours.
+	QSet<int> changedFolders;
+	for (QHash<QString, int>::const_iterator it = folderIds.constBegin(); it != folderIds.constEnd(); ++it)
+	{
+		int folderId = it.value();
+		int previousRank = previousRanks[folderId];
+		int rank = folderRanks[folderId];
+		if (previousRank == rank)
+			continue;
+
+		if ((previousRank >= 0) != (rank >= 0))
+		{
+			// updateWinner skips providers that aren't loaded, so the toggled folder has to be recounted here.
+			countsDirty[folderId] = true;
+			changedFolders.insert(folderId);
+			continue;
+		}
+
+		const QHash<int, int>& overlaps = folderOverlaps[folderId];
+		for (QHash<int, int>::const_iterator overlap = overlaps.constBegin(); overlap != overlaps.constEnd(); ++overlap)
+		{
+			int otherFolderId = overlap.key();
+			if (previousRanks[otherFolderId] < 0 || folderRanks[otherFolderId] < 0)
+				continue;
+
+			if ((previousRank < previousRanks[otherFolderId]) != (rank < folderRanks[otherFolderId]))
+			{
+				changedFolders.insert(folderId);
+				break;
+			}
+		}
+	}
+
+	foreach (int folderId, changedFolders)
+	{
+		foreach (int pathId, folderPaths[folderId])
+			updateWinner(pathId);
+	}
+}
+
+int ConflictIndex::getRank(int folderId) const
+{
+	return folderRanks.value(folderId, -1);
+}
+
+int ConflictIndex::getFilesWon(int folderId) const
+{
+	if (folderId < 0 || folderId >= filesWon.size())
+		return 0;
+
+	updateCounts(folderId);
+	return filesWon[folderId];
+}
+
+int ConflictIndex::getFilesLost(int folderId) const
+{
+	if (folderId < 0 || folderId >= filesLost.size())
+		return 0;
+
+	updateCounts(folderId);
+	return filesLost[folderId];
+}
+
+bool ConflictIndex::isFullyOverridden(int folderId) const
+{
+	if (getRank(folderId) < 0 || getFolderPaths(folderId).isEmpty())
+		return false;
+
+	return getFilesLost(folderId) == getFolderPaths(folderId).size();
+}
+
+int ConflictIndex::getIdenticalOverlapCount(int folderId, int otherFolderId) const
+{
+	if (folderId < 0 || folderId >= identicalOverlaps.size())
+		return 0;
+	return identicalOverlaps[folderId].value(otherFolderId, 0);
+}
+
+void ConflictIndex::setContentHash(int folderId, int pathId, quint64 hash)
+{
+	if (pathId < 0 || pathId >= providers.size())
+		return;
+
+	FolderIdList& pathProviders = providers[pathId];
+	ContentHashList& hashes = providerHashes[pathId];
+	int index = std::find(pathProviders.constBegin(), pathProviders.constEnd(), folderId) - pathProviders.constBegin();
+	if (index == pathProviders.size() || hashes[index] == hash)
+		return;
+
+	// Move this copy from the folders it used to match over to the ones it matches now.
+	quint64 previous = hashes[index];
+	for (int i = 0; i < pathProviders.size(); i++)
+	{
+		if (i == index)
+			continue;
+		if (previous != 0 && hashes[i] == previous)
+			changeIdenticalOverlap(folderId, pathProviders[i], -1);
+		if (hash != 0 && hashes[i] == hash)
+			changeIdenticalOverlap(folderId, pathProviders[i], 1);
+	}
+
+	hashes[index] = hash;
+	updateWinner(pathId);
+}
+
+quint64 ConflictIndex::getContentHash(int folderId, int pathId) const
+{
+	if (pathId < 0 || pathId >= providers.size())
+		return 0;
+
+	const FolderIdList& pathProviders = providers[pathId];
+	for (int i = 0; i < pathProviders.size(); i++)
+	{
+		if (pathProviders[i] == folderId)
+			return providerHashes[pathId][i];
+	}
+	return 0;
+}
+
+void ConflictIndex::setIgnoreIdentical(bool value)
+{
+	if (ignoreIdentical == value)
+		return;
+
+	ignoreIdentical = value;
+	countsDirty.fill(true);
+}
+
+bool ConflictIndex::ignoresIdentical() const
+{
+	return ignoreIdentical;
+}
+
+int ConflictIndex::getPathId(const QString& relativePath) const
+{
+	return pathIds.value(VfsPath(relativePath), -1);
+}
+
+QString ConflictIndex::getPath(int pathId) const
+{
+	return paths.value(pathId).toString();
+}
+
+const FolderIdList& ConflictIndex::getProviders(int pathId) const
+{
+	static const FolderIdList empty;
+	if (pathId < 0 || pathId >= providers.size())
+		return empty;
+	return providers[pathId];
+}
+
+QStringList ConflictIndex::getProviders(const QString& relativePath) const
+{
+	QStringList result;
+	const FolderIdList& pathProviders = getProviders(getPathId(relativePath));
+	for (int i = 0; i < pathProviders.size(); i++)
+		result.push_back(folders[pathProviders[i]]);
+	return result;
+}
+
+int ConflictIndex::getWinner(int pathId) const
+{
+	return winners.value(pathId, -1);
+}
+
+int ConflictIndex::getActiveProviderCount(int pathId) const
+{
+	return activeProviders.value(pathId, 0);
+}
+
+bool ConflictIndex::isIdentical(int pathId) const
+{
+	return identicalPaths.value(pathId, false);
+}
+
+int ConflictIndex::pathCount() const
+{
+	return pathIds.size();
+}
+
+int ConflictIndex::pathIdLimit() const
+{
+	return paths.size();
+}
+
+void ConflictIndex::clear()
+{
+	pathIds.clear();
+	paths.clear();
+	providers.clear();
+	providerHashes.clear();
+	winners.clear();
+	activeProviders.clear();
+	identicalPaths.clear();
+	freePathIds.clear();
+
+	folderIds.clear();
+	folders.clear();
+	folderPaths.clear();
+	folderOverlaps.clear();
+	identicalOverlaps.clear();
+	extraSpellings.clear();
+	freeFolderIds.clear();
+
+	folderRanks.clear();
+	filesWon.clear();
+	filesLost.clear();
+	countsDirty.clear();
+
+	searchIndex.clear();
+}
+
+int ConflictIndex::internPath(const QString& relativePath)
+{
+	VfsPath path(relativePath);
+	QHash<VfsPath, int>::const_iterator existing = pathIds.constFind(path);
+	if (existing != pathIds.constEnd())
+		return existing.value();
+
+	int pathId;
+	if (freePathIds.isEmpty())
+	{
+		pathId = paths.size();
+		paths.push_back(path);
+		providers.push_back(FolderIdList());
+		providerHashes.push_back(ContentHashList());
+		winners.push_back(-1);
+		activeProviders.push_back(0);
+		identicalPaths.push_back(false);
+	}
+	else
+	{
+		pathId = freePathIds.takeLast();
+		paths[pathId] = path;
+	}
+
+	pathIds.insert(path, pathId);
+	searchIndex.add(pathId, path.toString());
+	return pathId;
+}
+
+void ConflictIndex::releasePath(int pathId)
+{
+	searchIndex.remove(paths[pathId].toString());
+
+	pathIds.remove(paths[pathId]);
+	paths[pathId] = VfsPath();
+	providers[pathId].clear();
+	providerHashes[pathId].clear();
+	winners[pathId] = -1;
+	activeProviders[pathId] = 0;
+	identicalPaths[pathId] = false;
+	freePathIds.push_back(pathId);
+
+	// Released paths leave their entries behind; start over once those outnumber the live ones.
+	if (searchIndex.needsRebuild())
+		rebuildSearchIndex();
+}
+
+void ConflictIndex::removeProvider(int pathId, int index)
+{
+	FolderIdList& pathProviders = providers[pathId];
+	ContentHashList& hashes = providerHashes[pathId];
+
+	quint64 hash = hashes[index];
+	if (hash != 0)
+	{
+		for (int i = 0; i < pathProviders.size(); i++)
+		{
+			if (i != index && hashes[i] == hash)
+				changeIdenticalOverlap(pathProviders[index], pathProviders[i], -1);
+		}
+	}
+
+	pathProviders.remove(index);
+	hashes.remove(index);
+}
+
+void ConflictIndex::changeIdenticalOverlap(int folderId, int otherFolderId, int delta)
+{
+	if (folderId == otherFolderId)
+		return;
+
+	int& count = identicalOverlaps[folderId][otherFolderId];
+	count += delta;
+	if (count <= 0)
+		identicalOverlaps[folderId].remove(otherFolderId);
+
+	int& otherCount = identicalOverlaps[otherFolderId][folderId];
+	otherCount += delta;
+	if (otherCount <= 0)
+		identicalOverlaps[otherFolderId].remove(folderId);
+}
+
+void ConflictIndex::changeOverlap(int folderId, int otherFolderId, int delta)
+{
+	if (folderId == otherFolderId)
+		return;
+
+	int& count = folderOverlaps[folderId][otherFolderId];
+	count += delta;
+	if (count <= 0)
+		folderOverlaps[folderId].remove(otherFolderId);
+
+	int& otherCount = folderOverlaps[otherFolderId][folderId];
+	otherCount += delta;
+	if (otherCount <= 0)
+		folderOverlaps[otherFolderId].remove(folderId);
+}
+
+void ConflictIndex::updateWinner(int pathId)
+{
+	const FolderIdList& pathProviders = providers[pathId];
+
+	const ContentHashList& hashes = providerHashes[pathId];
+
+	int winner = -1;
+	int winnerRank = -1;
+	int active = 0;
+	quint64 firstHash = 0;
+	bool identical = true;
+	for (int i = 0; i < pathProviders.size(); i++)
+	{
+		int folderId = pathProviders[i];
+		int rank = folderRanks[folderId];
+		if (rank < 0)
+			continue;
+
+		// Identical only once every loaded copy has been hashed and they all agree.
+		if (active == 0)
+			firstHash = hashes[i];
+		if (hashes[i] == 0 || hashes[i] != firstHash)
+			identical = false;
+
+		active++;
+		if (rank > winnerRank)
+		{
+			winner = folderId;
+			winnerRank = rank;
+		}
+
+		countsDirty[folderId] = true;
+	}
+
+	winners[pathId] = winner;
+	activeProviders[pathId] = active;
+	identicalPaths[pathId] = identical && active >= 2;
+}
+
+void ConflictIndex::updateCounts(int folderId) const
+{
+	if (!countsDirty[folderId])
+		return;
+
+	int won = 0;
+	int lost = 0;
+	if (folderRanks[folderId] >= 0)
+	{
+		foreach (int pathId, folderPaths[folderId])
+		{
+			if (activeProviders[pathId] < 2 || (ignoreIdentical && identicalPaths[pathId]))
+				continue;
+
+			if (winners[pathId] == folderId)
+				won++;
+			else
+				lost++;
+		}
+	}
+
+	filesWon[folderId] = won;
+	filesLost[folderId] = lost;
+	countsDirty[folderId] = false;
+}
+
+//! Turns a normalized query into a WildcardUnix pattern, and the pieces every match has to contain.
+//! Returns false when it has no wildcards; a '[' that no ']' closes is just part of a name.
+static bool parseGlob(const QString& query, QString& pattern, QStringList& literals)
+{
+	bool glob = false;
+	QString literal;
+	for (int i = 0; i < query.size(); i++)
+	{
+		QChar c = query[i];
+		int close = c == '[' ? query.indexOf(']', i + 2) : -1;
+		if (c == '*' || c == '?' || close > 0)
+		{
+			glob = true;
+			if (!literal.isEmpty())
+				literals.push_back(literal);
+			literal.clear();
+
+			if (close > 0)
+			{
+				pattern += query.mid(i, close - i + 1);
+				i = close;
+			}
+			else
+				pattern += c;
+			continue;
+		}
+
+		if (c == '[' || c == ']')
+			pattern += '\\';
+		pattern += c;
+		literal += c;
+	}
+
+	if (!literal.isEmpty())
+		literals.push_back(literal);
+	return glob;
+}
+
+QVector<int> ConflictIndex::findPaths(const QString& pattern, int limit) const
+{
+	QVector<int> results;
+	QString query = VfsPath::normalize(pattern.trimmed());
+	if (query.isEmpty() || limit <= 0)
+		return results;
+
+	QString wildcard;
+	QStringList literals;
+	bool glob = parseGlob(query, wildcard, literals);
+	QRegExp matcher(wildcard, Qt::CaseSensitive, QRegExp::WildcardUnix);
+	if (!glob)
+		literals = QStringList() << query;
+
+	QVector<int> candidates;
+	bool narrowed = searchIndex.getCandidates(literals, candidates);
+
+	int end = narrowed ? candidates.size() : paths.size();
+	for (int i = 0; i < end; i++)
+	{
+		int pathId = narrowed ? candidates[i] : i;
+		const QString& path = paths[pathId].toString();
+		if (path.isEmpty())
+			continue;
+
+		if (glob ? matcher.exactMatch(path) : path.contains(query))
+			results.push_back(pathId);
+	}
+
+	// Only the first paths in order are kept, without sorting every match.
+	int kept = qMin(limit, results.size());
+	std::partial_sort(results.begin(), results.begin() + kept, results.end(), PathLess(paths));
+	results.resize(kept);
+	return results;
+}
+
+void ConflictIndex::rebuildSearchIndex()
+{
+	searchIndex.clear();
+	for (int pathId = 0; pathId < paths.size(); pathId++)
+	{
+		if (!paths[pathId].toString().isEmpty())
+			searchIndex.add(pathId, paths[pathId].toString());
+	}
+}
@@ -0,0 +1,117 @@
+#ifndef CONFLICTINDEX_H
+#define CONFLICTINDEX_H
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVarLengthArray>
+#include <QVector>
+
+#include "PathSearchIndex.h"
+#include "VfsPath.h"
+
+// Nearly every path is provided by one or two folders, so keep those inline.
+typedef QVarLengthArray<int, 2> FolderIdList;
+// Content hash of each provider's copy, in the same order. 0 means not hashed yet.
+typedef QVarLengthArray<quint64, 2> ContentHashList;
+
+/**
+ * Maps every relative path found in the data folders to the folders that provide it.
+ * Paths are normalized like OpenMW's VFS does, so case and slash differences still conflict.
+ * Paths and folders are interned to integer IDs, which are recycled when they are removed.
+ */
+class ConflictIndex
+{
+public:
+	ConflictIndex();
+
+	// Folders
+	void addFolder(const QString& folder, const QStringList& relativePaths);
+	void removeFolder(const QString& folder);
+	void addPaths(const QString& folder, const QStringList& relativePaths);
+	void removePaths(const QString& folder, const QStringList& relativePaths);
+	bool containsFolder(const QString& folder) const;
+
+	int getFolderId(const QString& folder) const;
+	QString getFolder(int folderId) const;
+	const QVector<int>& getFolderPaths(int folderId) const;
+	int folderCount() const;
+
+	// Overlapping folders, mapped to the number of paths they share.
+	const QHash<int, int>& getOverlaps(int folderId) const;
+	int getOverlapCount(int folderId, int otherFolderId) const;
+	// How many of those shared paths have byte-identical copies in both folders.
+	int getIdenticalOverlapCount(int folderId, int otherFolderId) const;
+
+	// Content hashes. Paths where every loaded copy is identical can be left out of the counts.
+	void setContentHash(int folderId, int pathId, quint64 hash);
+	quint64 getContentHash(int folderId, int pathId) const;
+	void setIgnoreIdentical(bool value);
+	bool ignoresIdentical() const;
+
+	// Load order, lowest first. Folders missing from it aren't loaded and never win a path.
+	void setLoadOrder(const QStringList& order);
+	int getRank(int folderId) const;
+	int getFilesWon(int folderId) const;
+	int getFilesLost(int folderId) const;
+	// Loaded, but every one of its files comes from somewhere else.
+	bool isFullyOverridden(int folderId) const;
+
+	// Paths
+	int getPathId(const QString& relativePath) const;
+	QString getPath(int pathId) const;
+	const FolderIdList& getProviders(int pathId) const;
+	QStringList getProviders(const QString& relativePath) const;
+	int getWinner(int pathId) const;
+	int getActiveProviderCount(int pathId) const;
+	bool isIdentical(int pathId) const;
+	int pathCount() const;
+	// Every path ID is below this, though some of them may currently be free.
+	int pathIdLimit() const;
+	// Paths containing the pattern, or matching it as a whole if it has wildcards (*, ? or a closed [...]), sorted.
+	QVector<int> findPaths(const QString& pattern, int limit) const;
+
+	void clear();
+
+private:
+	int internPath(const QString& relativePath);
+	void releasePath(int pathId);
+	void removeProvider(int pathId, int index);
+	void changeOverlap(int folderId, int otherFolderId, int delta);
+	void changeIdenticalOverlap(int folderId, int otherFolderId, int delta);
+	void updateWinner(int pathId);
+	void updateCounts(int folderId) const;
+	void rebuildSearchIndex();
+
+	QHash<VfsPath, int> pathIds;
+	QVector<VfsPath> paths;
+	QVector<FolderIdList> providers;
+	QVector<ContentHashList> providerHashes;
+	QVector<int> winners;
+	QVector<int> activeProviders;
+	QVector<bool> identicalPaths;
+	QVector<int> freePathIds;
+
+	QHash<QString, int> folderIds;
+	QVector<QString> folders;
+	QVector<QVector<int> > folderPaths;
+	QVector<QHash<int, int> > folderOverlaps;
+	QVector<QHash<int, int> > identicalOverlaps;
+	// Spellings of a path beyond the first that a folder has on disk, for names that only differ by case.
+	QVector<QHash<int, int> > extraSpellings;
+	QVector<int> freeFolderIds;
+
+	QHash<QString, int> loadOrder;
+	QVector<int> folderRanks;
+	bool ignoreIdentical;
+
+	// Won/lost counts are only recounted when asked for after one of the folder's paths changed hands.
+	mutable QVector<int> filesWon;
+	mutable QVector<int> filesLost;
+	mutable QVector<bool> countsDirty;
+
+	// Kept up to date as paths are interned, so the first search doesn't have to build it.
+	PathSearchIndex searchIndex;
+};
+
+#endif // CONFLICTINDEX_H
@@ -0,0 +1,195 @@
+#include "ConflictMatrixModel.h"
+#include "Trace.h"
+
+#include <QTextStream>
+
+#include <algorithm>
+
+static bool moreShared(const OverlapRow& row, const OverlapRow& other)
+{
+	return row.shared > other.shared;
+}
+
+static QString csvField(const QString& value)
+{
+	if (!value.contains(',') && !value.contains('"') && !value.contains('\n'))
+		return value;
+
+	QString quoted = value;
+	quoted.replace('"', "\"\"");
+	return '"' + quoted + '"';
+}
+
+ConflictMatrixModel::ConflictMatrixModel(TreeModModel* modModel, QObject *parent)
+	: QAbstractTableModel(parent)
+{
+	model = modModel;
+
+	// Scans finish in bursts; refresh once they settle rather than after every folder.
+	refreshTimer.setSingleShot(true);
+	refreshTimer.setInterval(500);
+	connect(&refreshTimer, SIGNAL(timeout()),
+			this, SLOT(refresh()));
+	connect(model, SIGNAL(conflictsChanged()),
+			&refreshTimer, SLOT(start()));
+}
+
+void ConflictMatrixModel::refresh()
+{
+	TRACE_SCOPE("ConflictMatrixModel::refresh");
+	refreshTimer.stop();
+	beginResetModel();
+	rows.clear();
+
+	// Each pair is listed once, from the folder that loads first.
+	const ConflictIndex& conflicts = model->getConflicts();
+	foreach (const QString& folder, model->getLoadOrder())
+	{
+		int folderId = conflicts.getFolderId(folder);
+		if (folderId < 0)
+			continue;
+
+		int rank = conflicts.getRank(folderId);
+		const QHash<int, int>& overlaps = conflicts.getOverlaps(folderId);
+		for (QHash<int, int>::const_iterator overlap = overlaps.constBegin(); overlap != overlaps.constEnd(); ++overlap)
+		{
+			if (overlap.value() <= 0 || conflicts.getRank(overlap.key()) <= rank)
+				continue;
+
+			OverlapRow row;
+			row.first = folder;
+			row.later = conflicts.getFolder(overlap.key());
+			row.shared = overlap.value();
+			row.identical = conflicts.getIdenticalOverlapCount(folderId, overlap.key());
+			row.firstFiles = conflicts.getFolderPaths(folderId).size();
+			row.firstOverridden = conflicts.isFullyOverridden(folderId);
+			rows.push_back(row);
+		}
+	}
+
+	std::stable_sort(rows.begin(), rows.end(), moreShared);
+	endResetModel();
+}
+
+int ConflictMatrixModel::rowCount(const QModelIndex &parent) const
+{
+	if (parent.isValid())
+		return 0;
+	return rows.size();
+}
+
+int ConflictMatrixModel::columnCount(const QModelIndex &parent) const
+{
+	if (parent.isValid())
+		return 0;
+	return COLUMN_COUNT;
+}
+
+QVariant ConflictMatrixModel::data(const QModelIndex &index, int role) const
+{
+	if (!index.isValid() || index.row() >= rows.size())
+		return QVariant();
+
+	const OverlapRow& row = rows[index.row()];
+	if (role == Qt::DisplayRole || role == SortRole)
+	{
+		switch (index.column())
+		{
+		case COLUMN_FIRST:
+			return model->getDisplayName(row.first);
+		case COLUMN_LATER:
+			return model->getDisplayName(row.later);
+		case COLUMN_SHARED:
+			return row.shared;
+		case COLUMN_IDENTICAL:
+			return row.identical;
+		case COLUMN_SHARE:
+		{
+			double share = row.firstFiles > 0 ? 100.0 * row.shared / row.firstFiles : 0.0;
+			if (role == SortRole)
+				return share;
+			return QString::number(share, 'f', 1) + '%';
+		}
+		case COLUMN_OVERRIDDEN:
+			return getOverriddenText(row);
+		default:
+			break;
+		}
+	}
+	else if (role == Qt::ToolTipRole)
+	{
+		switch (index.column())
+		{
+		case COLUMN_FIRST:
+			return row.first;
+		case COLUMN_LATER:
+			return row.later;
+		case COLUMN_SHARE:
+			return tr("%1 of the %2 files in %3").arg(row.shared).arg(row.firstFiles).arg(model->getDisplayName(row.first));
+		default:
+			break;
+		}
+	}
+	else if (role == Qt::TextAlignmentRole && index.column() != COLUMN_FIRST && index.column() != COLUMN_LATER)
+	{
+		return int(Qt::AlignRight | Qt::AlignVCenter);
+	}
+
+	return QVariant();
+}
+
+QVariant ConflictMatrixModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+	if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+		return QVariant();
+
+	switch (section)
+	{
+	case COLUMN_FIRST:
+		return tr("Mod");
+	case COLUMN_LATER:
+		return tr("Overlaps with (loads later)");
+	case COLUMN_SHARED:
+		return tr("Shared files");
+	case COLUMN_IDENTICAL:
+		return tr("Identical");
+	case COLUMN_SHARE:
+		return tr("Share of mod");
+	case COLUMN_OVERRIDDEN:
+		return tr("Fully overridden");
+	default:
+		return QVariant();
+	}
+}
+
+QString ConflictMatrixModel::getOverriddenText(const OverlapRow& row) const
+{
+	if (row.firstFiles > 0 && row.shared == row.firstFiles)
+		return tr("By this mod");
+	if (row.firstOverridden)
+		return tr("By several mods");
+	return QString();
+}
+
+bool ConflictMatrixModel::writeCsv(QIODevice* device) const
+{
+	QTextStream output(device);
+	output.setCodec("UTF-8");
+
+	QStringList header;
+	for (int column = 0; column < COLUMN_COUNT; column++)
+		header.push_back(csvField(headerData(column, Qt::Horizontal).toString()));
+	output << header.join(',') << '\n';
+
+	// Folders rather than display names, so every line is unambiguous.
+	foreach (const OverlapRow& row, rows)
+	{
+		double share = row.firstFiles > 0 ? 100.0 * row.shared / row.firstFiles : 0.0;
+		output << csvField(row.first) << ',' << csvField(row.later) << ','
+			   << row.shared << ',' << row.identical << ','
+			   << QString::number(share, 'f', 1) << ',' << csvField(getOverriddenText(row)) << '\n';
+	}
+
+	output.flush();
+	return output.status() == QTextStream::Ok;
+}
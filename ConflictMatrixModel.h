@@ -0,0 +1,65 @@
+#ifndef CONFLICTMATRIXMODEL_H
+#define CONFLICTMATRIXMODEL_H
+
+#include <QAbstractTableModel>
+#include <QIODevice>
+#include <QString>
+#include <QTimer>
+#include <QVector>
+
+#include "TreeModModel.h"
+
+struct OverlapRow
+{
+	QString first;
+	QString later;
+	int shared;
+	int identical;
+	int firstFiles;
+	bool firstOverridden;
+};
+
+/**
+ * Every pair of loaded folders that share files, for the whole mod list at once: the sparse half of the
+ * folder-by-folder overlap matrix. The counts are the ones the conflict index keeps up to date as folders
+ * change, so a refresh only walks the pairs.
+ */
+class ConflictMatrixModel : public QAbstractTableModel
+{
+	Q_OBJECT
+public:
+	explicit ConflictMatrixModel(TreeModModel* modModel, QObject *parent = 0);
+
+	int rowCount(const QModelIndex &parent = QModelIndex()) const Q_DECL_OVERRIDE;
+	int columnCount(const QModelIndex &parent = QModelIndex()) const Q_DECL_OVERRIDE;
+	QVariant data(const QModelIndex &index, int role) const Q_DECL_OVERRIDE;
+	QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const Q_DECL_OVERRIDE;
+
+	// Comma-separated values, largest overlaps first.
+	bool writeCsv(QIODevice* device) const;
+
+	enum Columns {
+		COLUMN_FIRST,
+		COLUMN_LATER,
+		COLUMN_SHARED,
+		COLUMN_IDENTICAL,
+		COLUMN_SHARE,
+		COLUMN_OVERRIDDEN,
+		COLUMN_COUNT
+	};
+
+	// Raw values for sorting, where the display text wouldn't sort right.
+	static const int SortRole = Qt::UserRole;
+
+public slots:
+	void refresh();
+
+private:
+	QString getOverriddenText(const OverlapRow& row) const;
+
+	TreeModModel* model;
+	QTimer refreshTimer;
+	QVector<OverlapRow> rows;
+};
+
+#endif // CONFLICTMATRIXMODEL_H
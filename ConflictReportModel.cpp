@@ -0,0 +1,238 @@
+#include "ConflictReportModel.h"
+
+#include <QColor>
+#include <QMap>
+
+#include <algorithm>
+
+// Rows added per fetch, and how many candidate paths a fetch may look at once it has found some.
+static const int FETCH_ROWS = 256;
+static const int FETCH_CANDIDATES = 65536;
+
+ConflictReportModel::ConflictReportModel(TreeModModel* modModel, QObject *parent)
+	: QAbstractTableModel(parent)
+{
+	model = modModel;
+	filterPosition = 0;
+	cursor = 0;
+
+	// Scans finish in bursts; start over once they settle rather than after every folder.
+	resetTimer.setSingleShot(true);
+	resetTimer.setInterval(500);
+	connect(&resetTimer, SIGNAL(timeout()),
+			this, SLOT(reset()));
+	connect(model, SIGNAL(conflictsChanged()),
+			&resetTimer, SLOT(start()));
+	// Rows and the filter are IDs, which must not be shown once they may belong to other paths or folders.
+	connect(model, SIGNAL(pathsReleased()),
+			this, SLOT(reset()));
+}
+
+void ConflictReportModel::setFilterFolder(const QString& folder)
+{
+	if (folder == filterFolder)
+		return;
+
+	filterFolder = folder;
+	reset();
+}
+
+void ConflictReportModel::reset()
+{
+	resetTimer.stop();
+	beginResetModel();
+
+	const ConflictIndex& conflicts = model->getConflicts();
+	filterFolderIds.clear();
+	foreach (const QString& folder, model->getConflictFolders(filterFolder))
+	{
+		int folderId = conflicts.getFolderId(folder);
+		if (folderId >= 0)
+			filterFolderIds.push_back(folderId);
+	}
+
+	filterPosition = 0;
+	cursor = 0;
+	rows.clear();
+	endResetModel();
+}
+
+bool ConflictReportModel::canFetchMore(const QModelIndex &parent) const
+{
+	if (parent.isValid())
+		return false;
+
+	const ConflictIndex& conflicts = model->getConflicts();
+	if (filterFolder.isEmpty())
+		return cursor < conflicts.pathIdLimit();
+
+	for (int position = filterPosition; position < filterFolderIds.size(); position++)
+	{
+		int start = position == filterPosition ? cursor : 0;
+		if (start < conflicts.getFolderPaths(filterFolderIds[position]).size())
+			return true;
+	}
+	return false;
+}
+
+void ConflictReportModel::fetchMore(const QModelIndex &parent)
+{
+	if (parent.isValid())
+		return;
+
+	const ConflictIndex& conflicts = model->getConflicts();
+	QVector<int> found;
+	int candidates = 0;
+	// The view only asks again after rows arrive, so a fetch that has found nothing yet keeps going until the paths run out.
+	while (found.size() < FETCH_ROWS && (candidates < FETCH_CANDIDATES || found.isEmpty()))
+	{
+		int pathId;
+		if (filterFolder.isEmpty())
+		{
+			if (cursor >= conflicts.pathIdLimit())
+				break;
+			pathId = cursor++;
+		}
+		else
+		{
+			if (filterPosition >= filterFolderIds.size())
+				break;
+
+			const QVector<int>& folderPaths = conflicts.getFolderPaths(filterFolderIds[filterPosition]);
+			if (cursor >= folderPaths.size())
+			{
+				filterPosition++;
+				cursor = 0;
+				continue;
+			}
+			pathId = folderPaths[cursor++];
+		}
+
+		candidates++;
+		if (isConflict(pathId, filterPosition))
+			found.push_back(pathId);
+	}
+
+	if (found.isEmpty())
+		return;
+
+	beginInsertRows(QModelIndex(), rows.size(), rows.size() + found.size() - 1);
+	rows += found;
+	endInsertRows();
+}
+
+bool ConflictReportModel::isConflict(int pathId, int position) const
+{
+	const ConflictIndex& conflicts = model->getConflicts();
+	if (conflicts.getActiveProviderCount(pathId) < 2)
+		return false;
+	if (conflicts.ignoresIdentical() && conflicts.isIdentical(pathId))
+		return false;
+
+	// With several filtered folders, list a path under the first one that provides it only.
+	if (!filterFolder.isEmpty())
+	{
+		const FolderIdList& providers = conflicts.getProviders(pathId);
+		for (int earlier = 0; earlier < position; earlier++)
+		{
+			if (std::find(providers.begin(), providers.end(), filterFolderIds[earlier]) != providers.end())
+				return false;
+		}
+	}
+
+	return true;
+}
+
+//! Providers that are actually loaded, in load order, so the winner comes last.
+QList<int> ConflictReportModel::getLoadedProviders(int pathId) const
+{
+	const ConflictIndex& conflicts = model->getConflicts();
+	const FolderIdList& providers = conflicts.getProviders(pathId);
+
+	QMap<int, int> byRank;
+	for (int i = 0; i < providers.size(); i++)
+	{
+		int rank = conflicts.getRank(providers[i]);
+		if (rank >= 0)
+			byRank.insert(rank, providers[i]);
+	}
+	return byRank.values();
+}
+
+int ConflictReportModel::rowCount(const QModelIndex &parent) const
+{
+	if (parent.isValid())
+		return 0;
+	return rows.size();
+}
+
+int ConflictReportModel::columnCount(const QModelIndex &parent) const
+{
+	if (parent.isValid())
+		return 0;
+	return COLUMN_COUNT;
+}
+
+QVariant ConflictReportModel::data(const QModelIndex &modelIndex, int role) const
+{
+	if (!modelIndex.isValid() || modelIndex.row() >= rows.size())
+		return QVariant();
+
+	const ConflictIndex& conflicts = model->getConflicts();
+	int pathId = rows[modelIndex.row()];
+	int winner = conflicts.getWinner(pathId);
+
+	if (role == Qt::DisplayRole)
+	{
+		switch (modelIndex.column())
+		{
+		case COLUMN_PATH:
+			return conflicts.getPath(pathId);
+		case COLUMN_WINNER:
+			return winner < 0 ? QString() : model->getDisplayName(conflicts.getFolder(winner));
+		case COLUMN_PROVIDERS:
+		{
+			QStringList names;
+			foreach (int folderId, getLoadedProviders(pathId))
+				names.push_back(model->getDisplayName(conflicts.getFolder(folderId)));
+			return names.join(", ");
+		}
+		default:
+			break;
+		}
+	}
+	else if (role == Qt::ToolTipRole && modelIndex.column() == COLUMN_PROVIDERS)
+	{
+		QStringList folders;
+		foreach (int folderId, getLoadedProviders(pathId))
+			folders.push_back(conflicts.getFolder(folderId));
+		return folders.join("\n");
+	}
+	else if (role == Qt::TextColorRole && !filterFolderIds.isEmpty())
+	{
+		// Same colours as the mod list: red where something overrides the selected mod, blue where it wins.
+		if (filterFolderIds.contains(winner))
+			return QVariant(QColor(0, 0, 192));
+		return QVariant(QColor(255, 0, 0));
+	}
+
+	return QVariant();
+}
+
+QVariant ConflictReportModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+	if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+		return QVariant();
+
+	switch (section)
+	{
+	case COLUMN_PATH:
+		return tr("File");
+	case COLUMN_WINNER:
+		return tr("Winner");
+	case COLUMN_PROVIDERS:
+		return tr("Provided by");
+	default:
+		return QVariant();
+	}
+}
@@ -0,0 +1,57 @@
+#ifndef CONFLICTREPORTMODEL_H
+#define CONFLICTREPORTMODEL_H
+
+#include <QAbstractTableModel>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+
+#include "TreeModModel.h"
+
+/**
+ * Lists every path more than one loaded folder provides, with its providers and the winner.
+ * Rows are found a batch at a time as the view scrolls, so even huge installs open instantly.
+ */
+class ConflictReportModel : public QAbstractTableModel
+{
+	Q_OBJECT
+public:
+	explicit ConflictReportModel(TreeModModel* modModel, QObject *parent = 0);
+
+	void setFilterFolder(const QString& folder);
+
+	int rowCount(const QModelIndex &parent = QModelIndex()) const Q_DECL_OVERRIDE;
+	int columnCount(const QModelIndex &parent = QModelIndex()) const Q_DECL_OVERRIDE;
+	QVariant data(const QModelIndex &index, int role) const Q_DECL_OVERRIDE;
+	QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const Q_DECL_OVERRIDE;
+
+	bool canFetchMore(const QModelIndex &parent) const Q_DECL_OVERRIDE;
+	void fetchMore(const QModelIndex &parent) Q_DECL_OVERRIDE;
+
+	enum Columns {
+		COLUMN_PATH,
+		COLUMN_WINNER,
+		COLUMN_PROVIDERS,
+		COLUMN_COUNT
+	};
+
+private slots:
+	void reset();
+
+private:
+	bool isConflict(int pathId, int filterPosition) const;
+	QList<int> getLoadedProviders(int pathId) const;
+
+	TreeModModel* model;
+	QTimer resetTimer;
+
+	// Without a filter every path ID is a candidate; with one, only the paths of the filtered folders.
+	QString filterFolder;
+	QVector<int> filterFolderIds;
+	int filterPosition;
+	int cursor;
+
+	QVector<int> rows;
+};
+
+#endif // CONFLICTREPORTMODEL_H
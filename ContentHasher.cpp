@@ -0,0 +1,336 @@
+#include "ContentHasher.h"
+
+#include <QDataStream>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QtConcurrent>
+#include <QtEndian>
+
+#include "ScanCache.h"
+
+static const quint32 HASH_CACHE_MAGIC = 0x4f4d4d48; // "OMMH"
+static const quint32 HASH_CACHE_VERSION = 1;
+
+static const quint64 PRIME64_1 = Q_UINT64_C(0x9E3779B185EBCA87);
+static const quint64 PRIME64_2 = Q_UINT64_C(0xC2B2AE3D27D4EB4F);
+static const quint64 PRIME64_3 = Q_UINT64_C(0x165667B19E3779F9);
+static const quint64 PRIME64_4 = Q_UINT64_C(0x85EBCA77C2B2AE63);
+static const quint64 PRIME64_5 = Q_UINT64_C(0x27D4EB2F165667C5);
+
+static inline quint64 rotateLeft(quint64 value, int bits)
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+static inline quint64 xxhRound(quint64 accumulator, quint64 input)
+{
+	accumulator += input * PRIME64_2;
+	accumulator = rotateLeft(accumulator, 31);
+	return accumulator * PRIME64_1;
+}
+
+static inline quint64 xxhMergeRound(quint64 accumulator, quint64 value)
+{
+	accumulator ^= xxhRound(0, value);
+	return accumulator * PRIME64_1 + PRIME64_4;
+}
+
+ContentHashJob::ContentHashJob()
+{
+	offset = 0;
+	size = -1;
+}
+
+ContentHashRecord::ContentHashRecord()
+{
+	size = 0;
+	modified = 0;
+	hash = 0;
+}
+
+QDataStream& operator<<(QDataStream& stream, const ContentHashRecord& record)
+{
+	stream << record.size << record.modified << record.hash;
+	return stream;
+}
+
+QDataStream& operator>>(QDataStream& stream, ContentHashRecord& record)
+{
+	stream >> record.size >> record.modified >> record.hash;
+	return stream;
+}
+
+// QtConcurrent::mapped wants a function object that says what it returns.
+struct ContentHashFunctor
+{
+	typedef quint64 result_type;
+
+	ContentHasher* hasher;
+
+	quint64 operator()(const ContentHashJob& job) const
+	{
+		return hasher->hashJob(job);
+	}
+};
+
+ContentHasher::ContentHasher(const QString& cachePath, QObject *parent)
+	: QObject(parent)
+{
+	path = cachePath;
+	modified = false;
+	readOnly = false;
+	load();
+
+	connect(&watcher, SIGNAL(finished()),
+			this, SLOT(batchFinished()));
+}
+
+ContentHasher::~ContentHasher()
+{
+	watcher.cancel();
+	watcher.waitForFinished();
+	save();
+}
+
+static QString jobKey(const ContentHashJob& job)
+{
+	return job.folder + '\n' + job.relativePath;
+}
+
+void ContentHasher::hash(const QVector<ContentHashJob>& jobs)
+{
+	foreach (const ContentHashJob& job, jobs)
+	{
+		QString key = jobKey(job);
+		if (queuedJobs.contains(key))
+			continue;
+
+		queuedJobs.insert(key);
+		pendingJobs.push_back(job);
+	}
+
+	if (!watcher.isRunning())
+		startBatch();
+}
+
+bool ContentHasher::isIdle() const
+{
+	return !watcher.isRunning() && pendingJobs.isEmpty();
+}
+
+void ContentHasher::startBatch()
+{
+	if (pendingJobs.isEmpty())
+	{
+		emit finished();
+		return;
+	}
+
+	runningJobs = pendingJobs;
+	pendingJobs.clear();
+
+	ContentHashFunctor functor;
+	functor.hasher = this;
+	watcher.setFuture(QtConcurrent::mapped(runningJobs, functor));
+}
+
+void ContentHasher::batchFinished()
+{
+	if (watcher.isCanceled())
+		return;
+
+	foreach (const ContentHashJob& job, runningJobs)
+		queuedJobs.remove(jobKey(job));
+
+	emit hashed(runningJobs, watcher.future().results().toVector());
+	runningJobs.clear();
+	startBatch();
+}
+
+//! Runs on a worker thread. Returns 0 when the file can't be read.
+quint64 ContentHasher::hashJob(const ContentHashJob& job)
+{
+	qint64 fileModified;
+	quint64 inode;
+	if (!ScanCache::readSignature(job.filePath, fileModified, inode))
+		return 0;
+	qint64 fileSize = QFileInfo(job.filePath).size();
+
+	// Files inside archives are told apart by where they start.
+	QString key = job.size < 0 ? job.filePath : job.filePath + '#' + QString::number(job.offset);
+	{
+		QMutexLocker locker(&mutex);
+		QHash<QString, ContentHashRecord>::const_iterator cached = records.constFind(key);
+		if (cached != records.constEnd() && cached->size == fileSize && cached->modified == fileModified)
+		{
+			usedRecords.insert(key);
+			return cached->hash;
+		}
+	}
+
+	qint64 length = job.size < 0 ? fileSize - job.offset : job.size;
+	if (length < 0 || job.offset + length > fileSize)
+		return 0;
+
+	quint64 result;
+	if (length == 0)
+		result = xxh64(0, 0);
+	else
+	{
+		QFile file(job.filePath);
+		if (!file.open(QIODevice::ReadOnly))
+			return 0;
+
+		uchar* data = file.map(job.offset, length);
+		if (!data)
+			return 0;
+		result = xxh64(data, length);
+		file.unmap(data);
+	}
+
+	// 0 means "not hashed" everywhere else.
+	if (result == 0)
+		result = 1;
+
+	ContentHashRecord record;
+	record.size = fileSize;
+	record.modified = fileModified;
+	record.hash = result;
+
+	QMutexLocker locker(&mutex);
+	records.insert(key, record);
+	usedRecords.insert(key);
+	modified = true;
+	return result;
+}
+
+void ContentHasher::save()
+{
+	QMutexLocker locker(&mutex);
+
+	// Nothing was hashed this session, so the file on disk is as good as it gets.
+	if (readOnly || !modified)
+		return;
+
+	QSaveFile cacheFile(path);
+	if (!cacheFile.open(QIODevice::WriteOnly))
+	{
+		qWarning("Couldn't open hash cache for writing.");
+		return;
+	}
+
+	QHash<QString, ContentHashRecord> usedData;
+	foreach (const QString& key, usedRecords)
+	{
+		if (records.contains(key))
+			usedData[key] = records[key];
+	}
+
+	QDataStream stream(&cacheFile);
+	stream.setVersion(QDataStream::Qt_5_7);
+	stream << HASH_CACHE_MAGIC << HASH_CACHE_VERSION << usedData;
+
+	if (stream.status() != QDataStream::Ok || !cacheFile.commit())
+		qWarning("Couldn't write hash cache.");
+	else
+		modified = false;
+}
+
+void ContentHasher::setReadOnly(bool value)
+{
+	QMutexLocker locker(&mutex);
+	readOnly = value;
+}
+
+void ContentHasher::load()
+{
+	QMutexLocker locker(&mutex);
+	records.clear();
+	usedRecords.clear();
+
+	QFile cacheFile(path);
+	if (!cacheFile.open(QIODevice::ReadOnly))
+		return;
+
+	QDataStream stream(&cacheFile);
+	stream.setVersion(QDataStream::Qt_5_7);
+
+	quint32 magic, version;
+	stream >> magic >> version;
+	if (magic != HASH_CACHE_MAGIC || version != HASH_CACHE_VERSION)
+		return;
+
+	stream >> records;
+	if (stream.status() != QDataStream::Ok)
+	{
+		qWarning("Hash cache is corrupt; files will be hashed again.");
+		records.clear();
+	}
+}
+
+//! XXH64, as specified by the xxHash project.
+quint64 ContentHasher::xxh64(const uchar* data, qint64 length, quint64 seed)
+{
+	const uchar* position = data;
+	const uchar* end = data + length;
+	quint64 hash;
+
+	if (length >= 32)
+	{
+		const uchar* limit = end - 32;
+		quint64 v1 = seed + PRIME64_1 + PRIME64_2;
+		quint64 v2 = seed + PRIME64_2;
+		quint64 v3 = seed;
+		quint64 v4 = seed - PRIME64_1;
+		do
+		{
+			v1 = xxhRound(v1, qFromLittleEndian<quint64>(position));
+			v2 = xxhRound(v2, qFromLittleEndian<quint64>(position + 8));
+			v3 = xxhRound(v3, qFromLittleEndian<quint64>(position + 16));
+			v4 = xxhRound(v4, qFromLittleEndian<quint64>(position + 24));
+			position += 32;
+		} while (position <= limit);
+
+		hash = rotateLeft(v1, 1) + rotateLeft(v2, 7) + rotateLeft(v3, 12) + rotateLeft(v4, 18);
+		hash = xxhMergeRound(hash, v1);
+		hash = xxhMergeRound(hash, v2);
+		hash = xxhMergeRound(hash, v3);
+		hash = xxhMergeRound(hash, v4);
+	}
+	else
+	{
+		hash = seed + PRIME64_5;
+	}
+
+	hash += quint64(length);
+
+	while (position + 8 <= end)
+	{
+		hash ^= xxhRound(0, qFromLittleEndian<quint64>(position));
+		hash = rotateLeft(hash, 27) * PRIME64_1 + PRIME64_4;
+		position += 8;
+	}
+
+	if (position + 4 <= end)
+	{
+		hash ^= quint64(qFromLittleEndian<quint32>(position)) * PRIME64_1;
+		hash = rotateLeft(hash, 23) * PRIME64_2 + PRIME64_3;
+		position += 4;
+	}
+
+	while (position < end)
+	{
+		hash ^= quint64(*position) * PRIME64_5;
+		hash = rotateLeft(hash, 11) * PRIME64_1;
+		position++;
+	}
+
+	hash ^= hash >> 33;
+	hash *= PRIME64_2;
+	hash ^= hash >> 29;
+	hash *= PRIME64_3;
+	hash ^= hash >> 32;
+	return hash;
+}
@@ -0,0 +1,86 @@
+#ifndef CONTENTHASHER_H
+#define CONTENTHASHER_H
+
+#include <QFutureWatcher>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+/** One file to hash: a loose file, or a stretch of a BSA archive. */
+struct ContentHashJob
+{
+	ContentHashJob();
+
+	QString folder;
+	QString relativePath;
+	QString filePath;
+	qint64 offset;
+	qint64 size; // -1 for the whole file
+};
+
+struct ContentHashRecord
+{
+	ContentHashRecord();
+
+	qint64 size;
+	qint64 modified;
+	quint64 hash;
+};
+
+QDataStream& operator<<(QDataStream& stream, const ContentHashRecord& record);
+QDataStream& operator>>(QDataStream& stream, ContentHashRecord& record);
+
+/**
+ * Hashes file contents with XXH64 on the global thread pool, straight out of memory maps.
+ * Hashes are remembered by size and modification time and saved next to the scan cache,
+ * so only files that changed are read again.
+ */
+class ContentHasher : public QObject
+{
+	Q_OBJECT
+public:
+	explicit ContentHasher(const QString& cachePath, QObject *parent = 0);
+	~ContentHasher();
+
+	// Jobs given while a batch is running are hashed right after it. Jobs already waiting or running are skipped.
+	void hash(const QVector<ContentHashJob>& jobs);
+	bool isIdle() const;
+
+	void save();
+	void load();
+	void setReadOnly(bool value);
+
+	static quint64 xxh64(const uchar* data, qint64 length, quint64 seed = 0);
+
+signals:
+	void hashed(const QVector<ContentHashJob>& jobs, const QVector<quint64>& hashes);
+	void finished();
+
+private slots:
+	void batchFinished();
+
+private:
+	friend struct ContentHashFunctor;
+
+	void startBatch();
+	quint64 hashJob(const ContentHashJob& job);
+
+	QString path;
+	QFutureWatcher<quint64> watcher;
+	QVector<ContentHashJob> runningJobs;
+	QVector<ContentHashJob> pendingJobs;
+	// Folder and relative path of every running or pending job.
+	QSet<QString> queuedJobs;
+
+	// Guarded by mutex; looked up and filled in from the worker threads.
+	QMutex mutex;
+	QHash<QString, ContentHashRecord> records;
+	QSet<QString> usedRecords;
+	bool modified;
+	bool readOnly;
+};
+
+#endif // CONTENTHASHER_H
@@ -0,0 +1,192 @@
+#include "EsmReader.h"
+
+#include <QDebug>
+#include <QtEndian>
+
+static inline quint32 makeTag(const char* name)
+{
+	return quint32(uchar(name[0])) | (quint32(uchar(name[1])) << 8) | (quint32(uchar(name[2])) << 16) | (quint32(uchar(name[3])) << 24);
+}
+
+static const quint32 TAG_TES3 = makeTag("TES3");
+static const quint32 TAG_CELL = makeTag("CELL");
+static const quint32 TAG_DIAL = makeTag("DIAL");
+static const quint32 TAG_INFO = makeTag("INFO");
+static const quint32 TAG_LAND = makeTag("LAND");
+static const quint32 TAG_MGEF = makeTag("MGEF");
+static const quint32 TAG_PGRD = makeTag("PGRD");
+static const quint32 TAG_SCPT = makeTag("SCPT");
+static const quint32 TAG_SKIL = makeTag("SKIL");
+
+static const quint32 TAG_DATA = makeTag("DATA");
+static const quint32 TAG_INAM = makeTag("INAM");
+static const quint32 TAG_INDX = makeTag("INDX");
+static const quint32 TAG_INTV = makeTag("INTV");
+static const quint32 TAG_NAME = makeTag("NAME");
+static const quint32 TAG_SCHD = makeTag("SCHD");
+
+static const int RECORD_HEADER_SIZE = 16;
+static const int SUBRECORD_HEADER_SIZE = 8;
+
+static QByteArray readString(const uchar* data, quint32 size)
+{
+	const char* string = reinterpret_cast<const char*>(data);
+	return QByteArray(string, int(qstrnlen(string, size)));
+}
+
+static QByteArray gridId(qint32 x, qint32 y)
+{
+	return QByteArray::number(x) + ',' + QByteArray::number(y);
+}
+
+EsmReader::EsmReader(const QString& pluginPath)
+	: file(pluginPath)
+{
+	data = 0;
+	size = 0;
+}
+
+EsmReader::~EsmReader()
+{
+	close();
+}
+
+bool EsmReader::open()
+{
+	close();
+
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	size = file.size();
+	if (size > 0)
+		data = file.map(0, size);
+
+	if (!data)
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void EsmReader::close()
+{
+	if (data)
+		file.unmap(data);
+	file.close();
+
+	data = 0;
+	size = 0;
+}
+
+bool EsmReader::isOpen() const
+{
+	return data != 0;
+}
+
+QStringList EsmReader::readRecordKeys() const
+{
+	QStringList keys;
+	if (!data)
+		return keys;
+
+	// INFO records are only unique within the DIAL record that came before them.
+	QByteArray dialogue;
+
+	const uchar* position = data;
+	const uchar* end = data + size;
+	while (end - position >= RECORD_HEADER_SIZE)
+	{
+		quint32 type = qFromLittleEndian<quint32>(position);
+		quint32 recordSize = qFromLittleEndian<quint32>(position + 4);
+		const uchar* record = position + RECORD_HEADER_SIZE;
+		if (quint64(end - record) < recordSize)
+		{
+			qWarning() << "Warning: Truncated record in '" + file.fileName() + "'";
+			break;
+		}
+
+		if (type != TAG_TES3)
+		{
+			QByteArray id = findRecordId(type, record, recordSize, dialogue);
+			if (!id.isEmpty())
+				keys.push_back(QString::fromLatin1(reinterpret_cast<const char*>(position), 4) + ':' + QString::fromLatin1(id).toLower());
+		}
+
+		position = record + recordSize;
+	}
+
+	return keys;
+}
+
+QStringList EsmReader::readPlugin(const QString& pluginPath)
+{
+	EsmReader reader(pluginPath);
+	if (!reader.open())
+		return QStringList();
+
+	return reader.readRecordKeys();
+}
+
+QByteArray EsmReader::findRecordId(quint32 type, const uchar* record, quint32 size, QByteArray& dialogue) const
+{
+	QByteArray name;
+	qint32 gridX = 0;
+	qint32 gridY = 0;
+	bool hasGrid = false;
+	bool interior = false;
+
+	const uchar* position = record;
+	const uchar* end = record + size;
+	while (end - position >= SUBRECORD_HEADER_SIZE)
+	{
+		quint32 subType = qFromLittleEndian<quint32>(position);
+		quint32 subSize = qFromLittleEndian<quint32>(position + 4);
+		const uchar* sub = position + SUBRECORD_HEADER_SIZE;
+		if (quint64(end - sub) < subSize)
+			break;
+
+		if (type == TAG_SCPT && subType == TAG_SCHD)
+			return readString(sub, qMin(subSize, quint32(32)));
+		if ((type == TAG_SKIL || type == TAG_MGEF) && subType == TAG_INDX && subSize >= 4)
+			return QByteArray::number(qFromLittleEndian<qint32>(sub));
+		if (type == TAG_LAND && subType == TAG_INTV && subSize >= 8)
+			return gridId(qFromLittleEndian<qint32>(sub), qFromLittleEndian<qint32>(sub + 4));
+		if (type == TAG_INFO && subType == TAG_INAM)
+			return dialogue + ':' + readString(sub, subSize);
+
+		if (subType == TAG_NAME)
+		{
+			name = readString(sub, subSize);
+			if (type == TAG_DIAL)
+				dialogue = name;
+			if (type != TAG_CELL && type != TAG_PGRD)
+				return name;
+		}
+		else if (subType == TAG_DATA && type == TAG_CELL && subSize >= 12)
+		{
+			interior = (qFromLittleEndian<quint32>(sub) & 1) != 0;
+			gridX = qFromLittleEndian<qint32>(sub + 4);
+			gridY = qFromLittleEndian<qint32>(sub + 8);
+			hasGrid = true;
+		}
+		else if (subType == TAG_DATA && type == TAG_PGRD && subSize >= 8)
+		{
+			gridX = qFromLittleEndian<qint32>(sub);
+			gridY = qFromLittleEndian<qint32>(sub + 4);
+			hasGrid = true;
+		}
+
+		position = sub + subSize;
+	}
+
+	// Exterior cells are known by their grid position; their names are often empty or shared.
+	if (type == TAG_CELL)
+		return (interior || !hasGrid) ? name : "#" + gridId(gridX, gridY);
+	if (type == TAG_PGRD)
+		return hasGrid ? name + '#' + gridId(gridX, gridY) : name;
+
+	return name;
+}
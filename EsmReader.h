@@ -0,0 +1,36 @@
+#ifndef ESMREADER_H
+#define ESMREADER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QStringList>
+
+/**
+ * Walks the records of a TES3 content file (ESM/ESP) straight out of a memory map.
+ * Only record and subrecord headers are looked at, plus the subrecord holding each record's ID.
+ */
+class EsmReader
+{
+public:
+	EsmReader(const QString& pluginPath);
+	~EsmReader();
+
+	bool open();
+	void close();
+	bool isOpen() const;
+
+	// Record keys look like "NPC_:fargoth", so that the same record from two plugins compares equal.
+	QStringList readRecordKeys() const;
+
+	static QStringList readPlugin(const QString& pluginPath);
+
+private:
+	QByteArray findRecordId(quint32 type, const uchar* record, quint32 size, QByteArray& dialogue) const;
+
+	QFile file;
+	uchar* data;
+	qint64 size;
+};
+
+#endif // ESMREADER_H
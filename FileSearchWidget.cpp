@@ -0,0 +1,155 @@
+#include "FileSearchWidget.h"
+#include "Trace.h"
+
+#include <QScrollBar>
+#include <QSet>
+#include <QVBoxLayout>
+
+// Past this many paths the query is too broad to be useful anyway.
+static const int MAX_RESULTS = 500;
+static const int FOLDER_ROLE = Qt::UserRole;
+
+FileSearchWidget::FileSearchWidget(TreeModModel* modModel, QWidget *parent)
+	: QWidget(parent)
+{
+	model = modModel;
+
+	queryEdit = new QLineEdit(this);
+	queryEdit->setPlaceholderText(tr("Find a file, e.g. ex_hlaalu_b_01.nif or meshes/x/*.nif"));
+	queryEdit->setToolTip(tr("Text is found anywhere in a path. With * ? or [...] the whole path has to match."));
+	queryEdit->setClearButtonEnabled(true);
+
+	results = new QTreeWidget(this);
+	results->setColumnCount(COLUMN_COUNT);
+	results->setHeaderLabels(QStringList() << tr("File / Mod") << tr("Folder") << tr("State"));
+	results->setUniformRowHeights(true);
+
+	QVBoxLayout* layout = new QVBoxLayout(this);
+	layout->setContentsMargins(0, 0, 0, 0);
+	layout->addWidget(queryEdit);
+	layout->addWidget(results);
+
+	// Wait for a pause in typing, and search again when folders change; that only redraws if the results differ.
+	searchTimer.setSingleShot(true);
+	searchTimer.setInterval(150);
+	connect(&searchTimer, SIGNAL(timeout()),
+			this, SLOT(search()));
+	connect(queryEdit, SIGNAL(textChanged(QString)),
+			&searchTimer, SLOT(start()));
+	connect(model, SIGNAL(conflictsChanged()),
+			&searchTimer, SLOT(start()));
+	connect(results, SIGNAL(itemActivated(QTreeWidgetItem*,int)),
+			this, SLOT(activateItem(QTreeWidgetItem*)));
+}
+
+void FileSearchWidget::search()
+{
+	TRACE_SCOPE("FileSearchWidget::search");
+	const ConflictIndex& conflicts = model->getConflicts();
+	QString query = queryEdit->text();
+	QVector<int> pathIds = conflicts.findPaths(query, MAX_RESULTS);
+
+	QStringList shown;
+	QList<QTreeWidgetItem*> items;
+	foreach (int pathId, pathIds)
+	{
+		QTreeWidgetItem* pathItem = new QTreeWidgetItem();
+		pathItem->setText(COLUMN_NAME, conflicts.getPath(pathId));
+		shown.push_back(pathItem->text(COLUMN_NAME));
+
+		int winner = conflicts.getWinner(pathId);
+		foreach (const QString& folder, model->getProviderFolders(pathId))
+		{
+			QTreeWidgetItem* providerItem = new QTreeWidgetItem(pathItem);
+			providerItem->setText(COLUMN_NAME, model->getDisplayName(folder));
+			providerItem->setText(COLUMN_FOLDER, folder);
+			providerItem->setData(COLUMN_NAME, FOLDER_ROLE, folder);
+
+			int folderId = conflicts.getFolderId(folder);
+			if (folderId == winner)
+			{
+				providerItem->setText(COLUMN_STATE, tr("Wins"));
+				QFont font = providerItem->font(COLUMN_NAME);
+				font.setBold(true);
+				providerItem->setFont(COLUMN_NAME, font);
+			}
+			else if (conflicts.getRank(folderId) < 0)
+			{
+				providerItem->setText(COLUMN_STATE, tr("Not loaded"));
+				for (int column = 0; column < COLUMN_COUNT; column++)
+					providerItem->setForeground(column, palette().brush(QPalette::Disabled, QPalette::Text));
+			}
+			shown.push_back('\t' + providerItem->text(COLUMN_NAME) + '\t' + folder + '\t' + providerItem->text(COLUMN_STATE));
+		}
+		items.push_back(pathItem);
+	}
+
+	// Scans and hashing change the index constantly; leave the list alone unless these results changed.
+	bool refresh = query == shownQuery;
+	if (refresh && shown == shownResults)
+	{
+		qDeleteAll(items);
+		return;
+	}
+
+	// Same query with other results: keep what the user opened, picked and scrolled to.
+	QSet<QString> expandedPaths;
+	QString currentPath;
+	QString currentFolder;
+	int scrollPosition = results->verticalScrollBar()->value();
+	if (refresh)
+	{
+		for (int i = 0; i < results->topLevelItemCount(); i++)
+		{
+			if (results->topLevelItem(i)->isExpanded())
+				expandedPaths.insert(results->topLevelItem(i)->text(COLUMN_NAME));
+		}
+
+		QTreeWidgetItem* current = results->currentItem();
+		if (current && current->parent())
+		{
+			currentPath = current->parent()->text(COLUMN_NAME);
+			currentFolder = current->data(COLUMN_NAME, FOLDER_ROLE).toString();
+		}
+		else if (current)
+			currentPath = current->text(COLUMN_NAME);
+	}
+
+	shownQuery = query;
+	shownResults = shown;
+	results->clear();
+	results->addTopLevelItems(items);
+
+	if (refresh)
+	{
+		foreach (QTreeWidgetItem* pathItem, items)
+		{
+			if (expandedPaths.contains(pathItem->text(COLUMN_NAME)))
+				pathItem->setExpanded(true);
+			if (pathItem->text(COLUMN_NAME) != currentPath)
+				continue;
+
+			results->setCurrentItem(pathItem);
+			for (int i = 0; i < pathItem->childCount(); i++)
+			{
+				if (pathItem->child(i)->data(COLUMN_NAME, FOLDER_ROLE).toString() == currentFolder)
+					results->setCurrentItem(pathItem->child(i));
+			}
+		}
+		results->verticalScrollBar()->setValue(scrollPosition);
+	}
+	else if (pathIds.size() <= 20)
+		results->expandAll();
+
+	if (pathIds.size() == MAX_RESULTS)
+		results->setHeaderLabels(QStringList() << tr("File / Mod (first %1)").arg(MAX_RESULTS) << tr("Folder") << tr("State"));
+	else
+		results->setHeaderLabels(QStringList() << tr("File / Mod") << tr("Folder") << tr("State"));
+}
+
+void FileSearchWidget::activateItem(QTreeWidgetItem* item)
+{
+	QString folder = item->data(COLUMN_NAME, FOLDER_ROLE).toString();
+	if (!folder.isEmpty())
+		emit folderActivated(folder);
+}
@@ -0,0 +1,46 @@
+#ifndef FILESEARCHWIDGET_H
+#define FILESEARCHWIDGET_H
+
+#include <QLineEdit>
+#include <QTimer>
+#include <QTreeWidget>
+#include <QWidget>
+
+#include "TreeModModel.h"
+
+/**
+ * "Which mod provides this file?": a search box over every path in the data folders.
+ * Each matching path lists the folders that provide it in mod list order, with the winner marked.
+ */
+class FileSearchWidget : public QWidget
+{
+	Q_OBJECT
+public:
+	explicit FileSearchWidget(TreeModModel* modModel, QWidget *parent = 0);
+
+	enum Columns {
+		COLUMN_NAME,
+		COLUMN_FOLDER,
+		COLUMN_STATE,
+		COLUMN_COUNT
+	};
+
+signals:
+	void folderActivated(const QString& folder);
+
+private slots:
+	void search();
+	void activateItem(QTreeWidgetItem* item);
+
+private:
+	TreeModModel* model;
+	QLineEdit* queryEdit;
+	QTreeWidget* results;
+	QTimer searchTimer;
+
+	// What is on screen, one line per path and provider, so refreshes that change nothing can be skipped.
+	QString shownQuery;
+	QStringList shownResults;
+};
+
+#endif // FILESEARCHWIDGET_H
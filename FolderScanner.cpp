@@ -0,0 +1,252 @@
+#include "FolderScanner.h"
+
+#include "BsaArchive.h"
+#include "Trace.h"
+
+#include <QDir>
+#include <QMutexLocker>
+#include <QRunnable>
+
+class FolderScanJob : public QRunnable
+{
+public:
+	explicit FolderScanJob(FolderScanner* owner)
+	{
+		scanner = owner;
+	}
+
+	void run() Q_DECL_OVERRIDE
+	{
+		QString folder;
+		int generation;
+		while (scanner->takeNext(folder, generation))
+		{
+			QStringList relativePaths;
+			bool cancelled = !scanFolder(folder, generation, relativePaths);
+
+			if (!cancelled)
+			{
+				QMetaObject::invokeMethod(scanner, "jobFinished", Qt::QueuedConnection,
+										  Q_ARG(QString, folder), Q_ARG(int, generation), Q_ARG(QStringList, relativePaths));
+			}
+		}
+	}
+
+private:
+	bool scanFolder(const QString& folder, int generation, QStringList& relativePaths)
+	{
+		TRACE_SCOPE("FolderScanJob::scanFolder");
+
+		// Archives only need their name table read; there's nothing worth caching.
+		if (folder.endsWith(".bsa", Qt::CaseInsensitive))
+		{
+			BsaArchive archive(folder);
+			if (archive.open())
+				relativePaths = archive.fileNames();
+			return true;
+		}
+
+		ScanCache* cache = scanner->getCache();
+		ScanDirectoryMap cached;
+		if (cache)
+			cached = cache->lookup(folder);
+
+		// Walk one directory at a time, so that unchanged directories can come straight from the cache.
+		ScanDirectoryMap scanned;
+		QStringList pendingDirectories;
+		pendingDirectories.push_back(QString());
+		while (!pendingDirectories.isEmpty())
+		{
+			if (scanner->isCancelled(folder, generation))
+				return false;
+
+			QString relativeDirectory = pendingDirectories.takeLast();
+			QString absoluteDirectory = relativeDirectory.isEmpty() ? folder : folder + "/" + relativeDirectory;
+
+			ScanDirectory directory;
+			if (!ScanCache::readSignature(absoluteDirectory, directory.modified, directory.inode))
+				continue;
+
+			ScanDirectoryMap::const_iterator previous = cached.constFind(relativeDirectory);
+			if (previous != cached.constEnd() && previous->modified == directory.modified && previous->inode == directory.inode)
+			{
+				directory = previous.value();
+			}
+			else
+			{
+				QDir dir(absoluteDirectory);
+				directory.files = dir.entryList(QDir::Files);
+				directory.subdirectories = dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks);
+			}
+
+			QString prefix = relativeDirectory.isEmpty() ? QString() : relativeDirectory + "/";
+			foreach (const QString& file, directory.files)
+				relativePaths.push_back(prefix + file);
+			foreach (const QString& subdirectory, directory.subdirectories)
+				pendingDirectories.push_back(prefix + subdirectory);
+
+			scanned.insert(relativeDirectory, directory);
+		}
+
+		if (cache)
+			cache->store(folder, scanned);
+
+		return true;
+	}
+
+	FolderScanner* scanner;
+};
+
+FolderScanner::FolderScanner(QObject *parent)
+	: QObject(parent)
+{
+	cache = 0;
+	nextGeneration = 0;
+	runningWorkers = 0;
+	doneCount = 0;
+	totalCount = 0;
+}
+
+FolderScanner::~FolderScanner()
+{
+	cancelAll();
+	pool.waitForDone();
+}
+
+void FolderScanner::setCache(ScanCache* scanCache)
+{
+	QMutexLocker locker(&mutex);
+	cache = scanCache;
+}
+
+ScanCache* FolderScanner::getCache()
+{
+	QMutexLocker locker(&mutex);
+	return cache;
+}
+
+void FolderScanner::enqueue(const QString& folder)
+{
+	enqueue(QStringList(folder));
+}
+
+//! Queues a batch under one lock, with a single progress update.
+void FolderScanner::enqueue(const QStringList& folders)
+{
+	{
+		QMutexLocker locker(&mutex);
+
+		foreach (const QString& folder, folders)
+		{
+			if (folder.isEmpty())
+				continue;
+
+			// A folder that is queued or running again only gets a new generation; stale results are dropped.
+			generations[folder] = nextGeneration++;
+			if (!pending.contains(folder))
+				pending.push_back(folder);
+		}
+
+		startWorkers();
+	}
+
+	updateProgress();
+}
+
+void FolderScanner::cancel(const QString& folder)
+{
+	{
+		QMutexLocker locker(&mutex);
+		if (!generations.remove(folder))
+			return;
+		pending.removeAll(folder);
+	}
+
+	updateProgress();
+}
+
+void FolderScanner::prioritize(const QString& folder)
+{
+	QMutexLocker locker(&mutex);
+	if (pending.removeOne(folder))
+		pending.push_front(folder);
+}
+
+void FolderScanner::cancelAll()
+{
+	QMutexLocker locker(&mutex);
+	pending.clear();
+	generations.clear();
+	doneCount = 0;
+	totalCount = 0;
+}
+
+bool FolderScanner::isIdle() const
+{
+	QMutexLocker locker(&mutex);
+	return generations.isEmpty();
+}
+
+bool FolderScanner::takeNext(QString& folder, int& generation)
+{
+	QMutexLocker locker(&mutex);
+	if (pending.isEmpty())
+	{
+		runningWorkers--;
+		return false;
+	}
+
+	folder = pending.takeFirst();
+	generation = generations.value(folder, -1);
+	return true;
+}
+
+bool FolderScanner::isCancelled(const QString& folder, int generation)
+{
+	QMutexLocker locker(&mutex);
+	return generations.value(folder, -1) != generation;
+}
+
+//! Must be called with the mutex held.
+void FolderScanner::startWorkers()
+{
+	while (runningWorkers < pool.maxThreadCount() && runningWorkers < pending.size())
+	{
+		runningWorkers++;
+		pool.start(new FolderScanJob(this));
+	}
+}
+
+void FolderScanner::updateProgress()
+{
+	bool idle;
+	int done;
+	int total;
+	{
+		QMutexLocker locker(&mutex);
+		idle = generations.isEmpty();
+		if (idle)
+			doneCount = 0;
+		totalCount = doneCount + generations.size();
+		done = doneCount;
+		total = totalCount;
+	}
+
+	emit progressChanged(done, total);
+	if (idle)
+		emit finished();
+}
+
+void FolderScanner::jobFinished(const QString& folder, int generation, const QStringList& relativePaths)
+{
+	{
+		QMutexLocker locker(&mutex);
+		if (generations.value(folder, -1) != generation)
+			return;
+		generations.remove(folder);
+		doneCount++;
+	}
+
+	emit folderScanned(folder, relativePaths);
+	updateProgress();
+}
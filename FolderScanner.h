@@ -0,0 +1,65 @@
+#ifndef FOLDERSCANNER_H
+#define FOLDERSCANNER_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+
+#include "ScanCache.h"
+
+class FolderScanner : public QObject
+{
+	Q_OBJECT
+public:
+	explicit FolderScanner(QObject *parent = 0);
+	~FolderScanner();
+
+	void setCache(ScanCache* scanCache);
+	ScanCache* getCache();
+
+	// Queue management. Everything here must be called from the owning thread.
+	void enqueue(const QString& folder);
+	void enqueue(const QStringList& folders);
+	void cancel(const QString& folder);
+	void prioritize(const QString& folder);
+	void cancelAll();
+
+	bool isIdle() const;
+
+signals:
+	void folderScanned(const QString& folder, const QStringList& relativePaths);
+	void progressChanged(int done, int total);
+	void finished();
+
+private slots:
+	void jobFinished(const QString& folder, int generation, const QStringList& relativePaths);
+
+private:
+	friend class FolderScanJob;
+
+	// Called from worker threads.
+	bool takeNext(QString& folder, int& generation);
+	bool isCancelled(const QString& folder, int generation);
+
+	void startWorkers();
+	void updateProgress();
+
+	QThreadPool pool;
+
+	// Guarded by mutex.
+	ScanCache* cache;
+	mutable QMutex mutex;
+	QList<QString> pending;
+	QHash<QString, int> generations;
+	int nextGeneration;
+	int runningWorkers;
+
+	int doneCount;
+	int totalCount;
+};
+
+#endif // FOLDERSCANNER_H
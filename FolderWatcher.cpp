@@ -0,0 +1,291 @@
+#include "FolderWatcher.h"
+
+#include <QDir>
+#include <QFile>
+
+#include <algorithm>
+
+static bool parentsFirst(const QString& left, const QString& right)
+{
+	return left.length() < right.length();
+}
+
+// QSet::fromList is deprecated since Qt 5.14, and the range constructor only came with it.
+static QSet<QString> toSet(const QStringList& list)
+{
+	QSet<QString> set;
+	set.reserve(list.size());
+	foreach (const QString& item, list)
+		set.insert(item);
+	return set;
+}
+
+FolderWatcher::FolderWatcher(ScanCache* scanCache, QObject *parent)
+	: QObject(parent)
+{
+	cache = scanCache;
+	watchBudget = defaultWatchBudget();
+	watchedPathCount = 0;
+
+	connect(&watcher, SIGNAL(directoryChanged(QString)),
+			this, SLOT(directoryChanged(QString)));
+
+	// Unpacking a mod touches the same directories many times; collect it all into one batch.
+	debounceTimer.setSingleShot(true);
+	debounceTimer.setInterval(500);
+	connect(&debounceTimer, SIGNAL(timeout()),
+			this, SLOT(processChanges()));
+
+	pollTimer.setInterval(30000);
+	connect(&pollTimer, SIGNAL(timeout()),
+			this, SLOT(pollFolders()));
+}
+
+void FolderWatcher::watchFolder(const QString& folder)
+{
+	unwatchFolder(folder);
+
+	ScanDirectoryMap directories = cache->lookup(folder);
+	if (directories.isEmpty())
+		return;
+
+	if (watchedPathCount + directories.size() > watchBudget)
+	{
+		fallBackToPolling(folder);
+		return;
+	}
+
+	for (ScanDirectoryMap::const_iterator it = directories.constBegin(); it != directories.constEnd(); ++it)
+	{
+		if (!addWatch(folder, it.key()))
+		{
+			fallBackToPolling(folder);
+			return;
+		}
+	}
+}
+
+void FolderWatcher::unwatchFolder(const QString& folder)
+{
+	foreach (const QString& relativeDirectory, folderWatches.value(folder))
+		removeWatch(folder, relativeDirectory);
+	folderWatches.remove(folder);
+
+	polledFolders.remove(folder);
+	if (polledFolders.isEmpty())
+		pollTimer.stop();
+
+	pendingChanges.remove(folder);
+}
+
+void FolderWatcher::directoryChanged(const QString& path)
+{
+	// Sub-component folders live inside their parent's folder, so a directory can belong to several.
+	foreach (const QString& folder, watchedDirectories.values(path))
+	{
+		QString relativeDirectory = path == folder ? QString() : path.mid(folder.length() + 1);
+		pendingChanges[folder].insert(relativeDirectory);
+	}
+
+	if (!debounceTimer.isActive())
+		debounceTimer.start();
+}
+
+void FolderWatcher::processChanges()
+{
+	QHash<QString, QSet<QString> > changes = pendingChanges;
+	pendingChanges.clear();
+
+	for (QHash<QString, QSet<QString> >::const_iterator it = changes.constBegin(); it != changes.constEnd(); ++it)
+	{
+		const QString& folder = it.key();
+		ScanDirectoryMap directories = cache->lookup(folder);
+
+		// Parents go first, so that directories they lost are already gone by the time we get to them.
+		QStringList changedDirectories = it.value().values();
+		std::sort(changedDirectories.begin(), changedDirectories.end(), parentsFirst);
+
+		QStringList added;
+		QStringList removed;
+		foreach (const QString& relativeDirectory, changedDirectories)
+		{
+			if (directories.contains(relativeDirectory))
+				applyDirectoryChange(folder, relativeDirectory, directories, added, removed);
+		}
+
+		cache->store(folder, directories);
+		if (!added.isEmpty() || !removed.isEmpty())
+			emit filesChanged(folder, added, removed);
+	}
+}
+
+void FolderWatcher::pollFolders()
+{
+	foreach (const QString& folder, polledFolders)
+	{
+		ScanDirectoryMap directories = cache->lookup(folder);
+		for (ScanDirectoryMap::const_iterator it = directories.constBegin(); it != directories.constEnd(); ++it)
+		{
+			qint64 modified;
+			quint64 inode;
+			if (!ScanCache::readSignature(absolutePath(folder, it.key()), modified, inode) || modified != it->modified || inode != it->inode)
+				pendingChanges[folder].insert(it.key());
+		}
+	}
+
+	if (!pendingChanges.isEmpty())
+		processChanges();
+}
+
+void FolderWatcher::applyDirectoryChange(const QString& folder, const QString& relativeDirectory, ScanDirectoryMap& directories, QStringList& added, QStringList& removed)
+{
+	QString path = absolutePath(folder, relativeDirectory);
+	ScanDirectory previous = directories.value(relativeDirectory);
+
+	ScanDirectory current;
+	if (!ScanCache::readSignature(path, current.modified, current.inode))
+	{
+		removeDirectory(folder, relativeDirectory, directories, removed);
+		return;
+	}
+
+	QDir dir(path);
+	current.files = dir.entryList(QDir::Files);
+	current.subdirectories = dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks);
+	directories.insert(relativeDirectory, current);
+
+	// Renames show up as one name disappearing and another one appearing.
+	QString prefix = relativeDirectory.isEmpty() ? QString() : relativeDirectory + "/";
+	QSet<QString> previousFiles = toSet(previous.files);
+	QSet<QString> currentFiles = toSet(current.files);
+	foreach (const QString& file, current.files)
+	{
+		if (!previousFiles.contains(file))
+			added.push_back(prefix + file);
+	}
+	foreach (const QString& file, previous.files)
+	{
+		if (!currentFiles.contains(file))
+			removed.push_back(prefix + file);
+	}
+
+	QSet<QString> previousSubdirectories = toSet(previous.subdirectories);
+	QSet<QString> currentSubdirectories = toSet(current.subdirectories);
+	foreach (const QString& subdirectory, current.subdirectories)
+	{
+		if (!previousSubdirectories.contains(subdirectory))
+			addDirectory(folder, prefix + subdirectory, directories, added);
+	}
+	foreach (const QString& subdirectory, previous.subdirectories)
+	{
+		if (!currentSubdirectories.contains(subdirectory))
+			removeDirectory(folder, prefix + subdirectory, directories, removed);
+	}
+}
+
+void FolderWatcher::addDirectory(const QString& folder, const QString& relativeDirectory, ScanDirectoryMap& directories, QStringList& added)
+{
+	QString path = absolutePath(folder, relativeDirectory);
+
+	ScanDirectory directory;
+	if (!ScanCache::readSignature(path, directory.modified, directory.inode))
+		return;
+
+	QDir dir(path);
+	directory.files = dir.entryList(QDir::Files);
+	directory.subdirectories = dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks);
+	directories.insert(relativeDirectory, directory);
+
+	if (!addWatch(folder, relativeDirectory))
+		fallBackToPolling(folder);
+
+	QString prefix = relativeDirectory + "/";
+	foreach (const QString& file, directory.files)
+		added.push_back(prefix + file);
+	foreach (const QString& subdirectory, directory.subdirectories)
+		addDirectory(folder, prefix + subdirectory, directories, added);
+}
+
+void FolderWatcher::removeDirectory(const QString& folder, const QString& relativeDirectory, ScanDirectoryMap& directories, QStringList& removed)
+{
+	if (!directories.contains(relativeDirectory))
+		return;
+
+	ScanDirectory directory = directories.take(relativeDirectory);
+	removeWatch(folder, relativeDirectory);
+	if (folderWatches.contains(folder))
+		folderWatches[folder].remove(relativeDirectory);
+
+	QString prefix = relativeDirectory.isEmpty() ? QString() : relativeDirectory + "/";
+	foreach (const QString& file, directory.files)
+		removed.push_back(prefix + file);
+	foreach (const QString& subdirectory, directory.subdirectories)
+		removeDirectory(folder, prefix + subdirectory, directories, removed);
+}
+
+bool FolderWatcher::addWatch(const QString& folder, const QString& relativeDirectory)
+{
+	// Polled folders pick up new directories on their own.
+	if (polledFolders.contains(folder))
+		return true;
+
+	QString path = absolutePath(folder, relativeDirectory);
+	if (!watchedDirectories.contains(path))
+	{
+		if (watchedPathCount >= watchBudget || !watcher.addPath(path))
+			return false;
+		watchedPathCount++;
+	}
+	else if (watchedDirectories.contains(path, folder))
+	{
+		return true;
+	}
+
+	watchedDirectories.insert(path, folder);
+	folderWatches[folder].insert(relativeDirectory);
+	return true;
+}
+
+void FolderWatcher::removeWatch(const QString& folder, const QString& relativeDirectory)
+{
+	QString path = absolutePath(folder, relativeDirectory);
+	if (watchedDirectories.remove(path, folder) == 0 || watchedDirectories.contains(path))
+		return;
+
+	// A deleted directory is already gone from the watcher, but its slot in the budget is free all the same.
+	watcher.removePath(path);
+	watchedPathCount--;
+}
+
+void FolderWatcher::fallBackToPolling(const QString& folder)
+{
+	foreach (const QString& relativeDirectory, folderWatches.value(folder))
+		removeWatch(folder, relativeDirectory);
+	folderWatches.remove(folder);
+
+	polledFolders.insert(folder);
+	if (!pollTimer.isActive())
+		pollTimer.start();
+}
+
+QString FolderWatcher::absolutePath(const QString& folder, const QString& relativeDirectory)
+{
+	return relativeDirectory.isEmpty() ? folder : folder + "/" + relativeDirectory;
+}
+
+int FolderWatcher::defaultWatchBudget()
+{
+#ifdef Q_OS_LINUX
+	// Leave half of the user's inotify watches to everything else that is running.
+	QFile limits("/proc/sys/fs/inotify/max_user_watches");
+	if (limits.open(QIODevice::ReadOnly | QIODevice::Text))
+	{
+		bool converted = false;
+		int maxWatches = QString(limits.readLine()).trimmed().toInt(&converted);
+		if (converted && maxWatches > 0)
+			return maxWatches / 2;
+	}
+#endif
+
+	return 4096;
+}
@@ -0,0 +1,64 @@
+#ifndef FOLDERWATCHER_H
+#define FOLDERWATCHER_H
+
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+
+#include "ScanCache.h"
+
+/**
+ * Watches the directories of scanned data folders and reports which files appeared or disappeared.
+ * Directory listings come from the scan cache, so only the directories that changed get listed again.
+ * Folders that don't fit in the watch budget are polled by comparing directory signatures instead.
+ */
+class FolderWatcher : public QObject
+{
+	Q_OBJECT
+public:
+	explicit FolderWatcher(ScanCache* scanCache, QObject *parent = 0);
+
+	void watchFolder(const QString& folder);
+	void unwatchFolder(const QString& folder);
+
+signals:
+	void filesChanged(const QString& folder, const QStringList& added, const QStringList& removed);
+
+private slots:
+	void directoryChanged(const QString& path);
+	void processChanges();
+	void pollFolders();
+
+private:
+	void applyDirectoryChange(const QString& folder, const QString& relativeDirectory, ScanDirectoryMap& directories, QStringList& added, QStringList& removed);
+	void addDirectory(const QString& folder, const QString& relativeDirectory, ScanDirectoryMap& directories, QStringList& added);
+	void removeDirectory(const QString& folder, const QString& relativeDirectory, ScanDirectoryMap& directories, QStringList& removed);
+
+	bool addWatch(const QString& folder, const QString& relativeDirectory);
+	void removeWatch(const QString& folder, const QString& relativeDirectory);
+	void fallBackToPolling(const QString& folder);
+
+	static QString absolutePath(const QString& folder, const QString& relativeDirectory);
+	static int defaultWatchBudget();
+
+	ScanCache* cache;
+	QFileSystemWatcher watcher;
+	QTimer debounceTimer;
+	QTimer pollTimer;
+
+	int watchBudget;
+	// Directories can be watched for several folders at once; this counts each of them once.
+	int watchedPathCount;
+	QMultiHash<QString, QString> watchedDirectories;
+	QHash<QString, QSet<QString> > folderWatches;
+	QSet<QString> polledFolders;
+
+	// Relative directories per folder that changed since the last batch.
+	QHash<QString, QSet<QString> > pendingChanges;
+};
+
+#endif // FOLDERWATCHER_H
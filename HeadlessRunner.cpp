@@ -0,0 +1,199 @@
+#include "HeadlessRunner.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QTimer>
+
+#include <algorithm>
+
+HeadlessRunner::HeadlessRunner(const QString& configFolder, QObject *parent)
+	: QObject(parent)
+{
+	shouldPrintData = false;
+	hideIdentical = false;
+
+	settings = new SettingsInterface(configFolder + "/mods.json");
+	settings->setReadOnly(true);
+	openMWConfig = new OpenMWConfigInterface(configFolder + "/openmw.cfg");
+	openMWConfig->setReadOnly(true);
+
+	model = new TreeModModel(settings, openMWConfig);
+	model->getScanner()->getCache()->setReadOnly(true);
+	model->getHasher()->setReadOnly(true);
+}
+
+HeadlessRunner::~HeadlessRunner()
+{
+	// The model puts the data= list back into the config on the way out.
+	delete model;
+	delete settings;
+	delete openMWConfig;
+}
+
+void HeadlessRunner::setReportPath(const QString& path)
+{
+	reportPath = path;
+}
+
+void HeadlessRunner::setOverlapsPath(const QString& path)
+{
+	overlapsPath = path;
+}
+
+void HeadlessRunner::setPrintData(bool value)
+{
+	shouldPrintData = value;
+}
+
+void HeadlessRunner::setWriteConfig(bool value)
+{
+	openMWConfig->setReadOnly(!value);
+}
+
+void HeadlessRunner::setHideIdentical(bool value)
+{
+	hideIdentical = value;
+	model->setHashContents(value);
+	model->setHideIdentical(value);
+}
+
+void HeadlessRunner::start()
+{
+	// Scans were queued while the model loaded; the scanner's pool already uses every core.
+	FolderScanner* scanner = model->getScanner();
+	connect(scanner, SIGNAL(finished()),
+			this, SLOT(scanFinished()));
+	if (scanner->isIdle())
+		QTimer::singleShot(0, this, SLOT(scanFinished()));
+}
+
+void HeadlessRunner::scanFinished()
+{
+	// Archives are only found once the data folders are scanned, and then need scanning themselves.
+	FolderScanner* scanner = model->getScanner();
+	if (!scanner->isIdle())
+		return;
+	disconnect(scanner, SIGNAL(finished()),
+			this, SLOT(scanFinished()));
+
+	if (!hideIdentical)
+	{
+		writeOutputs();
+		return;
+	}
+
+	// Identical copies can only be left out once every conflicting file is hashed.
+	ContentHasher* hasher = model->getHasher();
+	model->hashConflicts();
+	if (hasher->isIdle())
+	{
+		writeOutputs();
+		return;
+	}
+
+	connect(hasher, SIGNAL(finished()),
+			this, SLOT(writeOutputs()));
+}
+
+void HeadlessRunner::writeOutputs()
+{
+	int result = 0;
+	if (!reportPath.isEmpty() && !writeReport())
+		result = 1;
+	if (!overlapsPath.isEmpty() && !writeOverlaps())
+		result = 1;
+
+	if (shouldPrintData)
+		printData();
+
+	QCoreApplication::exit(result);
+}
+
+//! A path of - means standard output.
+bool HeadlessRunner::openOutput(QFile& file, const QString& path)
+{
+	bool opened;
+	if (path == "-")
+		opened = file.open(stdout, QIODevice::WriteOnly | QIODevice::Text);
+	else
+	{
+		file.setFileName(path);
+		opened = file.open(QIODevice::WriteOnly | QIODevice::Text);
+	}
+
+	if (!opened)
+		qWarning() << "Couldn't open '" + path + "' for writing.";
+	return opened;
+}
+
+bool HeadlessRunner::writeReport()
+{
+	QFile reportFile;
+	if (!openOutput(reportFile, reportPath))
+		return false;
+
+	QTextStream report(&reportFile);
+	report.setCodec("UTF-8");
+
+	const ConflictIndex& conflicts = model->getConflicts();
+	foreach (const QString& folder, model->getLoadOrder())
+	{
+		int folderId = conflicts.getFolderId(folder);
+		if (folderId < 0)
+			continue;
+
+		int won = conflicts.getFilesWon(folderId);
+		int lost = conflicts.getFilesLost(folderId);
+		if (won == 0 && lost == 0)
+			continue;
+
+		report << folder << '\n';
+		report << "\twins " << won << ", loses " << lost << '\n';
+
+		// Only paths this folder wins are listed here, so every conflicting path shows up exactly once.
+		QStringList wonPaths;
+		foreach (int pathId, conflicts.getFolderPaths(folderId))
+		{
+			if (conflicts.getActiveProviderCount(pathId) < 2 || conflicts.getWinner(pathId) != folderId)
+				continue;
+			if (conflicts.ignoresIdentical() && conflicts.isIdentical(pathId))
+				continue;
+
+			QStringList losers;
+			const FolderIdList& providers = conflicts.getProviders(pathId);
+			for (int i = 0; i < providers.size(); i++)
+			{
+				if (providers[i] != folderId && conflicts.getRank(providers[i]) >= 0)
+					losers.push_back(conflicts.getFolder(providers[i]));
+			}
+
+			wonPaths.push_back("\t" + conflicts.getPath(pathId) + " <- " + losers.join(", "));
+		}
+
+		std::sort(wonPaths.begin(), wonPaths.end());
+		foreach (const QString& line, wonPaths)
+			report << line << '\n';
+	}
+
+	report.flush();
+	return report.status() == QTextStream::Ok;
+}
+
+bool HeadlessRunner::writeOverlaps()
+{
+	QFile overlapsFile;
+	if (!openOutput(overlapsFile, overlapsPath))
+		return false;
+
+	ConflictMatrixModel overlaps(model);
+	overlaps.refresh();
+	return overlaps.writeCsv(&overlapsFile);
+}
+
+void HeadlessRunner::printData()
+{
+	QTextStream output(stdout);
+	foreach (const QString& folder, model->getDataFolders())
+		output << "data=" << folder << '\n';
+}
@@ -0,0 +1,54 @@
+#ifndef HEADLESSRUNNER_H
+#define HEADLESSRUNNER_H
+
+#include <QFile>
+#include <QObject>
+#include <QString>
+#include <QTextStream>
+
+#include "ConflictMatrixModel.h"
+#include "OpenMWConfigInterface.h"
+#include "SettingsInterface.h"
+#include "TreeModModel.h"
+
+/**
+ * Runs the scanner and conflict engine without any widgets, for scripts and build boxes.
+ * Once every folder is scanned it writes what was asked for and quits the application.
+ * Nothing on disk is changed unless the regenerated data= list is explicitly written back.
+ */
+class HeadlessRunner : public QObject
+{
+	Q_OBJECT
+public:
+	explicit HeadlessRunner(const QString& configFolder, QObject *parent = 0);
+	~HeadlessRunner();
+
+	void setReportPath(const QString& path);
+	void setOverlapsPath(const QString& path);
+	void setPrintData(bool value);
+	void setWriteConfig(bool value);
+	void setHideIdentical(bool value);
+
+	void start();
+
+private slots:
+	void scanFinished();
+	void writeOutputs();
+
+private:
+	bool writeReport();
+	bool writeOverlaps();
+	bool openOutput(QFile& file, const QString& path);
+	void printData();
+
+	SettingsInterface* settings;
+	OpenMWConfigInterface* openMWConfig;
+	TreeModModel* model;
+
+	QString reportPath;
+	QString overlapsPath;
+	bool shouldPrintData;
+	bool hideIdentical;
+};
+
+#endif // HEADLESSRUNNER_H
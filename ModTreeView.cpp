@@ -0,0 +1,19 @@
+#include "ModTreeView.h"
+#include "TreeModMimeData.h"
+
+ModTreeView::ModTreeView(QWidget *parent)
+	: QTreeView(parent)
+{
+}
+
+void ModTreeView::dropEvent(QDropEvent* event)
+{
+	const TreeModMimeData* data = qobject_cast<const TreeModMimeData*>(event->mimeData());
+	bool internalMove = data && data->getModel() == model() && event->dropAction() == Qt::MoveAction;
+
+	QTreeView::dropEvent(event);
+
+	// Same as QListView: report a copy, so the drag leaves the moved rows alone.
+	if (internalMove && event->isAccepted())
+		event->setDropAction(Qt::CopyAction);
+}
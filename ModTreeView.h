@@ -0,0 +1,21 @@
+#ifndef MODTREEVIEW_H
+#define MODTREEVIEW_H
+
+#include <QDropEvent>
+#include <QTreeView>
+
+/**
+ * The mod tree's view. Rows dragged within it are moved by the model itself, so the drag must not
+ * remove them from where they were afterwards, which is what a successful move drop normally does.
+ */
+class ModTreeView : public QTreeView
+{
+	Q_OBJECT
+public:
+	explicit ModTreeView(QWidget *parent = 0);
+
+protected:
+	void dropEvent(QDropEvent* event) Q_DECL_OVERRIDE;
+};
+
+#endif // MODTREEVIEW_H
@@ -0,0 +1,49 @@
+# Everything but the window and the entry point, shared with the benchmark and replay tools.
+
+INCLUDEPATH += $$PWD
+
+SOURCES += $$PWD/TreeModModel.cpp \
+    $$PWD/TreeModItem.cpp \
+    $$PWD/SettingsInterface.cpp \
+    $$PWD/OpenMWConfigInterface.cpp \
+    $$PWD/FolderScanner.cpp \
+    $$PWD/ScanCache.cpp \
+    $$PWD/ConflictIndex.cpp \
+    $$PWD/FolderWatcher.cpp \
+    $$PWD/BsaArchive.cpp \
+    $$PWD/EsmReader.cpp \
+    $$PWD/RecordIndex.cpp \
+    $$PWD/RecordConflictModel.cpp \
+    $$PWD/VfsPath.cpp \
+    $$PWD/Trace.cpp \
+    $$PWD/ConflictReportModel.cpp \
+    $$PWD/ContentHasher.cpp \
+    $$PWD/SaveScheduler.cpp \
+    $$PWD/TreeModMimeData.cpp \
+    $$PWD/ModTreeView.cpp \
+    $$PWD/ConflictMatrixModel.cpp \
+    $$PWD/PathSearchIndex.cpp \
+    $$PWD/FileSearchWidget.cpp
+
+HEADERS += $$PWD/TreeModModel.h \
+    $$PWD/TreeModItem.h \
+    $$PWD/SettingsInterface.h \
+    $$PWD/OpenMWConfigInterface.h \
+    $$PWD/FolderScanner.h \
+    $$PWD/ScanCache.h \
+    $$PWD/ConflictIndex.h \
+    $$PWD/FolderWatcher.h \
+    $$PWD/BsaArchive.h \
+    $$PWD/EsmReader.h \
+    $$PWD/RecordIndex.h \
+    $$PWD/RecordConflictModel.h \
+    $$PWD/VfsPath.h \
+    $$PWD/Trace.h \
+    $$PWD/ConflictReportModel.h \
+    $$PWD/ContentHasher.h \
+    $$PWD/SaveScheduler.h \
+    $$PWD/TreeModMimeData.h \
+    $$PWD/ModTreeView.h \
+    $$PWD/ConflictMatrixModel.h \
+    $$PWD/PathSearchIndex.h \
+    $$PWD/FileSearchWidget.h
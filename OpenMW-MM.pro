@@ -4,25 +4,20 @@
 #
 #-------------------------------------------------
 
-QT       += core gui
+QT       += core gui concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 TARGET = OpenMW-MM
 TEMPLATE = app
 
+include(OpenMW-MM.pri)
 
 SOURCES += main.cpp\
         WinMain.cpp \
-    TreeModModel.cpp \
-    TreeModItem.cpp \
-    SettingsInterface.cpp \
-    OpenMWConfigInterface.cpp
+    HeadlessRunner.cpp
 
 HEADERS  += WinMain.h \
-    TreeModModel.h \
-    TreeModItem.h \
-    SettingsInterface.h \
-    OpenMWConfigInterface.h
+    HeadlessRunner.h
 
 FORMS    += WinMain.ui
@@ -1,7 +1,14 @@
 #include "OpenMWConfigInterface.h"
+#include "Trace.h"
+
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <cstring>
 
 OpenMWConfigInterface::OpenMWConfigInterface(const QString& configFilePath)
 {
+	readOnly = false;
 	setConfigPath(configFilePath);
 	load();
 }
@@ -28,47 +35,264 @@ QVector<QVariant>& OpenMWConfigInterface::getByKey(const QString &key)
 
 void OpenMWConfigInterface::save()
 {
-	QFile cfgFile(cfgPath);
-	if (!cfgFile.open(QIODevice::WriteOnly | QIODevice::Text))
+	if (readOnly || !isModified())
+		return;
+
+	TRACE_SCOPE("OpenMWConfigInterface::save");
+	QByteArray output = serialize();
+
+	QSaveFile cfgFile(cfgPath);
+	if (!cfgFile.open(QIODevice::WriteOnly))
 	{
 		qWarning("Couldn't open OpenMW config file for writing.");
 		return;
 	}
 
-	foreach(const QString& key, data.keys())
+	if (cfgFile.write(output) != output.size() || !cfgFile.commit())
+	{
+		qWarning("Couldn't write OpenMW config file.");
+		return;
+	}
+
+	markSaved(output);
+}
+
+bool OpenMWConfigInterface::isModified() const
+{
+	for (QMap<QString, QVector<QVariant> >::const_iterator it = data.constBegin(); it != data.constEnd(); ++it)
+	{
+		if (it.value() != savedData.value(it.key()))
+			return true;
+	}
+	return false;
+}
+
+QByteArray OpenMWConfigInterface::serialize() const
+{
+	QSet<QString> changedKeys;
+	for (QMap<QString, QVector<QVariant> >::const_iterator it = data.constBegin(); it != data.constEnd(); ++it)
+	{
+		if (it.value() != savedData.value(it.key()))
+			changedKeys.insert(it.key());
+	}
+
+	// Everything we don't manage is copied through untouched; a changed key is written where it first was.
+	QByteArray output;
+	output.reserve(contents.size() + 1024);
+	QSet<QString> writtenKeys;
+	foreach (const ConfigLine& line, lines)
 	{
-		foreach(const QVariant& value, data[key])
+		if (line.key.isEmpty() || !changedKeys.contains(line.key))
 		{
-			QString line = key + "=" + value.toString() + '\n';
-			cfgFile.write(line.toUtf8());
+			output.append(contents.constData() + line.offset, line.length);
+			continue;
 		}
+
+		if (writtenKeys.contains(line.key))
+			continue;
+
+		output += formatBlock(line.key, data.value(line.key));
+		writtenKeys.insert(line.key);
+	}
+
+	// Keys that weren't in the file yet go at the end.
+	for (QMap<QString, QVector<QVariant> >::const_iterator it = data.constBegin(); it != data.constEnd(); ++it)
+	{
+		if (!changedKeys.contains(it.key()) || writtenKeys.contains(it.key()) || it.value().isEmpty())
+			continue;
+
+		if (!output.isEmpty() && !output.endsWith('\n'))
+			output += lineEnding;
+		output += formatBlock(it.key(), it.value());
 	}
+
+	return output;
+}
+
+void OpenMWConfigInterface::markSaved(const QByteArray& output)
+{
+	// Anything changed since the snapshot was taken is still unsaved afterwards.
+	QMap<QString, QVector<QVariant> > current = data;
+	parse(output);
+	data = current;
 }
 
 void OpenMWConfigInterface::load()
 {
-	// Clear current map.
 	data.clear();
+	contents.clear();
+	lines.clear();
+	savedData.clear();
+	quotedKeys.clear();
+	lineEnding = "\n";
 
-	// Load json from settings file.
 	QFile cfgFile(cfgPath);
-	if (!cfgFile.open(QIODevice::ReadOnly | QIODevice::Text))
+	if (!cfgFile.open(QIODevice::ReadOnly))
 	{
 		qWarning("Couldn't open OpenMW config file for reading.");
 		return;
 	}
 
-	QString line;
-	line = cfgFile.readLine();
-	while (!line.isEmpty())
+	parse(cfgFile.readAll());
+}
+
+//! Splits the whole buffer into lines in one pass. Only keys and values are ever copied out of it.
+void OpenMWConfigInterface::parse(const QByteArray& buffer)
+{
+	contents = buffer;
+	lines.clear();
+	data.clear();
+	quotedKeys.clear();
+
+	const char* start = contents.constData();
+	const char* end = start + contents.size();
+
+	lineEnding = "\n";
+	const char* firstBreak = static_cast<const char*>(memchr(start, '\n', contents.size()));
+	if (firstBreak && firstBreak > start && firstBreak[-1] == '\r')
+		lineEnding = "\r\n";
+
+	// Keys come in blocks, so the previous key can usually be shared rather than allocated again.
+	QString previousKey;
+	QSet<QString> seenKeys;
+	const char* position = start;
+	while (position < end)
 	{
-		int splitIndex = line.indexOf('=');
-		insert(line.left(splitIndex).trimmed(), line.right(line.length()-splitIndex-1).trimmed());
-		line = cfgFile.readLine();
+		const char* lineBreak = static_cast<const char*>(memchr(position, '\n', end - position));
+		const char* next = lineBreak ? lineBreak + 1 : end;
+
+		const char* textBegin = position;
+		const char* textEnd = lineBreak ? lineBreak : end;
+		while (textBegin < textEnd && (*textBegin == ' ' || *textBegin == '\t'))
+			textBegin++;
+		while (textEnd > textBegin && (textEnd[-1] == ' ' || textEnd[-1] == '\t' || textEnd[-1] == '\r'))
+			textEnd--;
+
+		ConfigLine line;
+		line.offset = int(position - start);
+		line.length = int(next - position);
+
+		const char* equals = textBegin < textEnd && *textBegin != '#' ? static_cast<const char*>(memchr(textBegin, '=', textEnd - textBegin)) : 0;
+		if (equals)
+		{
+			const char* keyEnd = equals;
+			while (keyEnd > textBegin && (keyEnd[-1] == ' ' || keyEnd[-1] == '\t'))
+				keyEnd--;
+
+			if (previousKey.size() != keyEnd - textBegin || previousKey != QLatin1String(textBegin, int(keyEnd - textBegin)))
+				previousKey = QString::fromUtf8(textBegin, int(keyEnd - textBegin));
+			line.key = previousKey;
+
+			bool quoted = false;
+			data[line.key].push_back(parseValue(equals + 1, textEnd, quoted));
+
+			// Keys keep the quoting style of their first line when they are written back.
+			if (!seenKeys.contains(line.key))
+			{
+				seenKeys.insert(line.key);
+				if (quoted)
+					quotedKeys.insert(line.key);
+			}
+		}
+
+		lines.push_back(line);
+		position = next;
+	}
+
+	savedData = data;
+}
+
+QByteArray OpenMWConfigInterface::formatBlock(const QString& key, const QVector<QVariant>& values) const
+{
+	// OpenMW quotes data paths itself, so new ones are quoted to match.
+	bool quoted = quotedKeys.contains(key);
+	if (!savedData.contains(key))
+		quoted = key == "data" || key == "data-local";
+
+	QByteArray block;
+	QByteArray prefix = key.toUtf8() + '=';
+	foreach (const QVariant& value, values)
+	{
+		block += prefix;
+		block += formatValue(value.toString(), quoted);
+		block += lineEnding;
 	}
+	return block;
+}
+
+//! Values in quotes escape '&' and '"' with '&', the way OpenMW writes paths.
+QString OpenMWConfigInterface::parseValue(const char* begin, const char* end, bool& quoted)
+{
+	while (begin < end && (*begin == ' ' || *begin == '\t'))
+		begin++;
+
+	quoted = begin < end && *begin == '"';
+	if (!quoted)
+		return QString::fromUtf8(begin, int(end - begin));
+
+	QByteArray value;
+	value.reserve(int(end - begin));
+	for (const char* position = begin + 1; position < end; position++)
+	{
+		if (*position == '&' && position + 1 < end && (position[1] == '&' || position[1] == '"'))
+			value += *++position;
+		else if (*position == '"')
+			break;
+		else
+			value += *position;
+	}
+	return QString::fromUtf8(value);
+}
+
+QByteArray OpenMWConfigInterface::formatValue(const QString& value, bool quoted)
+{
+	QByteArray utf8 = value.toUtf8();
+	if (!quoted)
+		return utf8;
+
+	QByteArray escaped;
+	escaped.reserve(utf8.size() + 2);
+	escaped += '"';
+	foreach (char character, utf8)
+	{
+		if (character == '&' || character == '"')
+			escaped += '&';
+		escaped += character;
+	}
+	escaped += '"';
+	return escaped;
 }
 
 void OpenMWConfigInterface::setConfigPath(const QString& path)
 {
 	cfgPath = path;
 }
+
+QString OpenMWConfigInterface::getConfigPath() const
+{
+	return cfgPath;
+}
+
+void OpenMWConfigInterface::setReadOnly(bool value)
+{
+	readOnly = value;
+}
+
+bool OpenMWConfigInterface::isReadOnly() const
+{
+	return readOnly;
+}
+
+QString OpenMWConfigInterface::defaultConfigFolder()
+{
+	QString configFolder;
+	#if defined(Q_OS_MACOS)
+		configFolder = QStandardPaths::locate(QStandardPaths::ConfigLocation, "openmw", QStandardPaths::LocateDirectory);
+	#elif defined(Q_OS_WIN)
+		configFolder = QStandardPaths::locate(QStandardPaths::DocumentsLocation, "My Games/OpenMW", QStandardPaths::LocateDirectory);
+	#elif defined(Q_OS_LINUX)
+		// Default flatpak location
+		configFolder = QStandardPaths::locate(QStandardPaths::HomeLocation, ".var/app/org.openmw.OpenMW/config/openmw/", QStandardPaths::LocateDirectory);
+	#endif
+	return configFolder;
+}
@@ -1,13 +1,20 @@
 #ifndef OPENMWCONFIGINTERFACE_H
 #define OPENMWCONFIGINTERFACE_H
 
+#include <QByteArray>
 #include <QFile>
 #include <QMap>
+#include <QSet>
 #include <QString>
 #include <QSettings>
 #include <QVariant>
 #include <QVector>
 
+/**
+ * Reads and writes openmw.cfg without losing anything the launcher or the user put there.
+ * The file is kept as it was read; saving only rewrites the blocks of keys whose values changed,
+ * in the place they were first found, and appends keys that weren't there before.
+ */
 class OpenMWConfigInterface
 {
 public:
@@ -21,10 +28,43 @@ public:
 	void load();
 
 	void setConfigPath(const QString& path);
+	QString getConfigPath() const;
+	void setReadOnly(bool value);
+	bool isReadOnly() const;
+
+	// For saving elsewhere: serialize what would be written, then report it as written.
+	bool isModified() const;
+	QByteArray serialize() const;
+	void markSaved(const QByteArray& output);
+
+	/** Where OpenMW keeps its config on this platform, or an empty string if it isn't there. */
+	static QString defaultConfigFolder();
 
 private:
+	// One line of the file as it was read. Comments, blank lines and anything unparsable have no key.
+	struct ConfigLine
+	{
+		int offset;
+		int length;
+		QString key;
+	};
+
+	void parse(const QByteArray& buffer);
+	QByteArray formatBlock(const QString& key, const QVector<QVariant>& values) const;
+
+	static QString parseValue(const char* begin, const char* end, bool& quoted);
+	static QByteArray formatValue(const QString& value, bool quoted);
+
 	QString cfgPath;
+	bool readOnly;
 	QMap<QString, QVector<QVariant>> data;
+
+	// The file as last read or written, and what each key held then.
+	QByteArray contents;
+	QVector<ConfigLine> lines;
+	QMap<QString, QVector<QVariant>> savedData;
+	QSet<QString> quotedKeys;
+	QByteArray lineEnding;
 };
 
 #endif // OPENMWCONFIGINTERFACE_H
@@ -0,0 +1,81 @@
+#include "PathSearchIndex.h"
+
+#include <algorithm>
+
+PathSearchIndex::PathSearchIndex()
+{
+	entries = 0;
+	staleEntries = 0;
+}
+
+void PathSearchIndex::add(int pathId, const QString& path)
+{
+	QVector<quint64> trigrams = getTrigrams(path);
+	foreach (quint64 trigram, trigrams)
+		postings[trigram].push_back(pathId);
+	entries += trigrams.size();
+}
+
+//! Entries stay where they are; a recycled path ID that no longer matches is weeded out by the caller's check.
+void PathSearchIndex::remove(const QString& path)
+{
+	staleEntries += getTrigrams(path).size();
+}
+
+void PathSearchIndex::clear()
+{
+	postings.clear();
+	entries = 0;
+	staleEntries = 0;
+}
+
+bool PathSearchIndex::needsRebuild() const
+{
+	return staleEntries > entries - staleEntries;
+}
+
+bool PathSearchIndex::getCandidates(const QStringList& literals, QVector<int>& candidates) const
+{
+	// Every trigram of the query has to be there, so the shortest posting list is enough to go through.
+	const QVector<int>* shortest = 0;
+	foreach (const QString& literal, literals)
+	{
+		foreach (quint64 trigram, getTrigrams(literal))
+		{
+			QHash<quint64, QVector<int> >::const_iterator posting = postings.constFind(trigram);
+			if (posting == postings.constEnd())
+			{
+				candidates.clear();
+				return true;
+			}
+			if (!shortest || posting.value().size() < shortest->size())
+				shortest = &posting.value();
+		}
+	}
+
+	if (!shortest)
+		return false;
+
+	// A recycled path ID can be listed twice.
+	candidates = *shortest;
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+	return true;
+}
+
+QVector<quint64> PathSearchIndex::getTrigrams(const QString& text)
+{
+	QVector<quint64> trigrams;
+	if (text.size() < 3)
+		return trigrams;
+
+	trigrams.reserve(text.size() - 2);
+	const ushort* data = text.utf16();
+	for (int i = 0; i + 2 < text.size(); i++)
+		trigrams.push_back((quint64(data[i]) << 32) | (quint64(data[i + 1]) << 16) | data[i + 2]);
+
+	// Paths repeat trigrams often ("/meshes/m/..."); list each path once per trigram.
+	std::sort(trigrams.begin(), trigrams.end());
+	trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+	return trigrams;
+}
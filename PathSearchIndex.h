@@ -0,0 +1,37 @@
+#ifndef PATHSEARCHINDEX_H
+#define PATHSEARCHINDEX_H
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/**
+ * Trigram index over normalized paths, for finding paths by substring without looking at all of them.
+ * Lookups only narrow down the candidates; callers still check each one against the query.
+ * Removed paths leave their entries behind until there are enough of them to be worth rebuilding for.
+ */
+class PathSearchIndex
+{
+public:
+	PathSearchIndex();
+
+	void add(int pathId, const QString& path);
+	void remove(const QString& path);
+	void clear();
+
+	// Whether there are now more stale entries than live ones.
+	bool needsRebuild() const;
+
+	// Paths that may contain every one of the literals, or false when none is long enough to look up.
+	bool getCandidates(const QStringList& literals, QVector<int>& candidates) const;
+
+private:
+	static QVector<quint64> getTrigrams(const QString& text);
+
+	QHash<quint64, QVector<int> > postings;
+	int entries;
+	int staleEntries;
+};
+
+#endif // PATHSEARCHINDEX_H
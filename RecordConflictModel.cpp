@@ -0,0 +1,178 @@
+#include "RecordConflictModel.h"
+
+#include <QSet>
+#include <QtConcurrent>
+
+#include "EsmReader.h"
+
+RecordConflictModel::RecordConflictModel(QObject *parent)
+	: QAbstractTableModel(parent)
+{
+	connect(&parser, SIGNAL(finished()),
+			this, SLOT(parsingFinished()));
+}
+
+RecordConflictModel::~RecordConflictModel()
+{
+	parser.cancel();
+	parser.waitForFinished();
+}
+
+void RecordConflictModel::load(const QStringList& plugins, const QStringList& pluginPaths, const QStringList& pluginFolders)
+{
+	parser.cancel();
+	parser.waitForFinished();
+
+	pendingPlugins = plugins;
+	pendingFolders = pluginFolders;
+	parser.setFuture(QtConcurrent::mapped(pluginPaths, EsmReader::readPlugin));
+}
+
+bool RecordConflictModel::isLoading() const
+{
+	return parser.isRunning();
+}
+
+const RecordIndex& RecordConflictModel::getIndex() const
+{
+	return recordIndex;
+}
+
+void RecordConflictModel::parsingFinished()
+{
+	if (parser.isCanceled())
+		return;
+
+	beginResetModel();
+
+	// Results come back in the order the plugins were given, so load order is kept.
+	recordIndex.clear();
+	QFuture<QStringList> future = parser.future();
+	for (int i = 0; i < pendingPlugins.size(); i++)
+		recordIndex.addPlugin(pendingPlugins[i], future.resultAt(i));
+	pluginFolders = pendingFolders;
+
+	updateRows();
+	endResetModel();
+
+	emit loaded();
+}
+
+void RecordConflictModel::setFilterFolder(const QString& folder)
+{
+	if (folder == filterFolder)
+		return;
+
+	beginResetModel();
+	filterFolder = folder;
+	updateRows();
+	endResetModel();
+}
+
+void RecordConflictModel::updateRows()
+{
+	if (filterFolder.isEmpty())
+	{
+		rows = recordIndex.getConflicts();
+		return;
+	}
+
+	QSet<int> filterPlugins;
+	for (int pluginId = 0; pluginId < pluginFolders.size(); pluginId++)
+	{
+		if (pluginFolders[pluginId] == filterFolder)
+			filterPlugins.insert(pluginId);
+	}
+
+	rows.clear();
+	if (filterPlugins.isEmpty())
+		return;
+
+	foreach (int recordId, recordIndex.getConflicts())
+	{
+		const PluginIdList& plugins = recordIndex.getPlugins(recordId);
+		for (int i = 0; i < plugins.size(); i++)
+		{
+			if (filterPlugins.contains(plugins[i]))
+			{
+				rows.push_back(recordId);
+				break;
+			}
+		}
+	}
+}
+
+int RecordConflictModel::rowCount(const QModelIndex &parent) const
+{
+	if (parent.isValid())
+		return 0;
+	return rows.size();
+}
+
+int RecordConflictModel::columnCount(const QModelIndex &parent) const
+{
+	if (parent.isValid())
+		return 0;
+	return COLUMN_COUNT;
+}
+
+QVariant RecordConflictModel::data(const QModelIndex &modelIndex, int role) const
+{
+	if (!modelIndex.isValid() || modelIndex.row() >= rows.size())
+		return QVariant();
+
+	int recordId = rows[modelIndex.row()];
+	const PluginIdList& plugins = recordIndex.getPlugins(recordId);
+
+	if (role == Qt::DisplayRole)
+	{
+		QString record = recordIndex.getRecord(recordId);
+		switch (modelIndex.column())
+		{
+		case COLUMN_TYPE:
+			return record.left(4);
+		case COLUMN_ID:
+			return record.mid(5);
+		case COLUMN_PLUGINS:
+		{
+			QStringList names;
+			for (int i = 0; i < plugins.size(); i++)
+				names.push_back(recordIndex.getPlugin(plugins[i]));
+			return names.join(", ");
+		}
+		case COLUMN_WINNER:
+			return plugins.isEmpty() ? QString() : recordIndex.getPlugin(plugins[plugins.size() - 1]);
+		default:
+			break;
+		}
+	}
+	else if (role == Qt::ToolTipRole && modelIndex.column() == COLUMN_PLUGINS)
+	{
+		QStringList folders;
+		for (int i = 0; i < plugins.size(); i++)
+			folders.push_back(recordIndex.getPlugin(plugins[i]) + " (" + pluginFolders.value(plugins[i]) + ")");
+		return folders.join("\n");
+	}
+
+	return QVariant();
+}
+
+QVariant RecordConflictModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+	if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+		return QVariant();
+
+	switch (section)
+	{
+	case COLUMN_TYPE:
+		return tr("Type");
+	case COLUMN_ID:
+		return tr("Record");
+	case COLUMN_PLUGINS:
+		return tr("Plugins");
+	case COLUMN_WINNER:
+		return tr("Winner");
+	default:
+		return QVariant();
+	}
+}
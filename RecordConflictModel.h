@@ -0,0 +1,59 @@
+#ifndef RECORDCONFLICTMODEL_H
+#define RECORDCONFLICTMODEL_H
+
+#include <QAbstractTableModel>
+#include <QFutureWatcher>
+#include <QStringList>
+#include <QVector>
+
+#include "RecordIndex.h"
+
+/** Lists records that several content files define, optionally only those touched by one mod's plugins. */
+class RecordConflictModel : public QAbstractTableModel
+{
+	Q_OBJECT
+public:
+	explicit RecordConflictModel(QObject *parent = 0);
+	~RecordConflictModel();
+
+	// Plugins are parsed in parallel, and are given in content= order.
+	void load(const QStringList& plugins, const QStringList& pluginPaths, const QStringList& pluginFolders);
+	bool isLoading() const;
+	const RecordIndex& getIndex() const;
+
+	void setFilterFolder(const QString& folder);
+
+	int rowCount(const QModelIndex &parent = QModelIndex()) const Q_DECL_OVERRIDE;
+	int columnCount(const QModelIndex &parent = QModelIndex()) const Q_DECL_OVERRIDE;
+	QVariant data(const QModelIndex &index, int role) const Q_DECL_OVERRIDE;
+	QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const Q_DECL_OVERRIDE;
+
+	enum Columns {
+		COLUMN_TYPE,
+		COLUMN_ID,
+		COLUMN_PLUGINS,
+		COLUMN_WINNER,
+		COLUMN_COUNT
+	};
+
+signals:
+	void loaded();
+
+private slots:
+	void parsingFinished();
+
+private:
+	void updateRows();
+
+	QFutureWatcher<QStringList> parser;
+	QStringList pendingPlugins;
+	QStringList pendingFolders;
+
+	RecordIndex recordIndex;
+	QStringList pluginFolders;
+
+	QString filterFolder;
+	QVector<int> rows;
+};
+
+#endif // RECORDCONFLICTMODEL_H
@@ -0,0 +1,86 @@
+#include "RecordIndex.h"
+
+RecordIndex::RecordIndex()
+{
+}
+
+int RecordIndex::addPlugin(const QString& plugin, const QStringList& recordKeys)
+{
+	int pluginId = plugins.size();
+	plugins.push_back(plugin);
+
+	foreach (const QString& recordKey, recordKeys)
+	{
+		int recordId;
+		QHash<QString, int>::const_iterator existing = recordIds.constFind(recordKey);
+		if (existing != recordIds.constEnd())
+		{
+			recordId = existing.value();
+		}
+		else
+		{
+			recordId = records.size();
+			records.push_back(recordKey);
+			recordPlugins.push_back(PluginIdList());
+			recordIds.insert(recordKey, recordId);
+		}
+
+		// A plugin that defines the same record twice still only counts once.
+		PluginIdList& definedBy = recordPlugins[recordId];
+		if (!definedBy.isEmpty() && definedBy.last() == pluginId)
+			continue;
+
+		definedBy.append(pluginId);
+		if (definedBy.size() == 2)
+			conflicts.push_back(recordId);
+	}
+
+	return pluginId;
+}
+
+int RecordIndex::pluginCount() const
+{
+	return plugins.size();
+}
+
+QString RecordIndex::getPlugin(int pluginId) const
+{
+	return plugins.value(pluginId);
+}
+
+int RecordIndex::getRecordId(const QString& recordKey) const
+{
+	return recordIds.value(recordKey, -1);
+}
+
+QString RecordIndex::getRecord(int recordId) const
+{
+	return records.value(recordId);
+}
+
+const PluginIdList& RecordIndex::getPlugins(int recordId) const
+{
+	static const PluginIdList empty;
+	if (recordId < 0 || recordId >= recordPlugins.size())
+		return empty;
+	return recordPlugins[recordId];
+}
+
+int RecordIndex::recordCount() const
+{
+	return records.size();
+}
+
+const QVector<int>& RecordIndex::getConflicts() const
+{
+	return conflicts;
+}
+
+void RecordIndex::clear()
+{
+	plugins.clear();
+	recordIds.clear();
+	records.clear();
+	recordPlugins.clear();
+	conflicts.clear();
+}
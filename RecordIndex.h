@@ -0,0 +1,43 @@
+#ifndef RECORDINDEX_H
+#define RECORDINDEX_H
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVarLengthArray>
+#include <QVector>
+
+// Most records are only touched by their master, and maybe one plugin after it.
+typedef QVarLengthArray<int, 2> PluginIdList;
+
+/** Maps every record key to the content files that define it, in load order. */
+class RecordIndex
+{
+public:
+	RecordIndex();
+
+	// Plugins have to be added in content= order; the last plugin to define a record wins.
+	int addPlugin(const QString& plugin, const QStringList& recordKeys);
+	int pluginCount() const;
+	QString getPlugin(int pluginId) const;
+
+	int getRecordId(const QString& recordKey) const;
+	QString getRecord(int recordId) const;
+	const PluginIdList& getPlugins(int recordId) const;
+	int recordCount() const;
+
+	// Records defined by more than one plugin.
+	const QVector<int>& getConflicts() const;
+
+	void clear();
+
+private:
+	QStringList plugins;
+
+	QHash<QString, int> recordIds;
+	QVector<QString> records;
+	QVector<PluginIdList> recordPlugins;
+	QVector<int> conflicts;
+};
+
+#endif // RECORDINDEX_H
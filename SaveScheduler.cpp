@@ -0,0 +1,185 @@
+#include "SaveScheduler.h"
+
+#include <QSaveFile>
+#include <QtConcurrent>
+
+#include "Trace.h"
+
+SaveSnapshot::SaveSnapshot()
+{
+	jsonRevision = 0;
+	saveJson = false;
+	saveCfg = false;
+}
+
+SaveScheduler::SaveScheduler(TreeModModel* modModel, SettingsInterface* settingsInterface, OpenMWConfigInterface* configInterface, QObject *parent)
+	: QObject(parent)
+{
+	model = modModel;
+	settings = settingsInterface;
+	config = configInterface;
+	pending = false;
+
+	// Wait for a pause in editing, but don't let a long stream of edits put saving off forever.
+	quietTimer.setSingleShot(true);
+	quietTimer.setInterval(1000);
+	connect(&quietTimer, SIGNAL(timeout()),
+			this, SLOT(saveInBackground()));
+
+	deadlineTimer.setSingleShot(true);
+	deadlineTimer.setInterval(10000);
+	connect(&deadlineTimer, SIGNAL(timeout()),
+			this, SLOT(saveInBackground()));
+
+	connect(&writer, SIGNAL(finished()),
+			this, SLOT(saveFinished()));
+	connect(model, SIGNAL(modified()),
+			this, SLOT(schedule()));
+}
+
+SaveScheduler::~SaveScheduler()
+{
+	flush();
+}
+
+void SaveScheduler::schedule()
+{
+	pending = true;
+	quietTimer.start();
+	if (!deadlineTimer.isActive())
+		deadlineTimer.start();
+}
+
+void SaveScheduler::flush()
+{
+	quietTimer.stop();
+	deadlineTimer.stop();
+
+	// The finished signal won't get through before we exit, so handle it here.
+	if (writer.isRunning())
+	{
+		writer.waitForFinished();
+		saveFinished();
+	}
+
+	if (!pending)
+		return;
+
+	TRACE_SCOPE("SaveScheduler::flush");
+	pending = false;
+	SaveSnapshot snapshot = takeSnapshot();
+	if (writeSnapshot(snapshot))
+		markSaved(snapshot);
+}
+
+void SaveScheduler::saveInBackground()
+{
+	quietTimer.stop();
+	deadlineTimer.stop();
+
+	// One save at a time; whatever came in meanwhile goes right after this one.
+	if (writer.isRunning() || !pending)
+		return;
+
+	pending = false;
+	runningSnapshot = takeSnapshot();
+	if (!runningSnapshot.saveJson && !runningSnapshot.saveCfg)
+		return;
+
+	writer.setFuture(QtConcurrent::run(&SaveScheduler::writeSnapshot, runningSnapshot));
+}
+
+void SaveScheduler::saveFinished()
+{
+	if (!runningSnapshot.saveJson && !runningSnapshot.saveCfg)
+		return;
+
+	bool saved = writer.result();
+	if (saved)
+		markSaved(runningSnapshot);
+	runningSnapshot = SaveSnapshot();
+
+	if (!saved)
+	{
+		qWarning("Saving failed; trying again shortly.");
+		schedule();
+	}
+	else if (pending && !quietTimer.isActive())
+	{
+		saveInBackground();
+	}
+}
+
+void SaveScheduler::markSaved(const SaveSnapshot& snapshot)
+{
+	if (snapshot.saveJson)
+		settings->markSaved(snapshot.jsonRevision);
+	if (snapshot.saveCfg)
+		config->markSaved(snapshot.cfg);
+}
+
+SaveSnapshot SaveScheduler::takeSnapshot()
+{
+	TRACE_SCOPE("SaveScheduler::takeSnapshot");
+
+	// The tree only goes into the interfaces here, rather than on every edit.
+	model->storeToInterfaces();
+
+	SaveSnapshot snapshot;
+	snapshot.saveJson = !settings->isReadOnly() && settings->isModified();
+	if (snapshot.saveJson)
+	{
+		snapshot.jsonPath = settings->getJsonPath();
+		snapshot.json = settings->getJsonDoc();
+		snapshot.jsonRevision = settings->getRevision();
+		snapshot.binaryPath = settings->getBinaryPath();
+		snapshot.binaryRoot = settings->getRootWithoutMods();
+		snapshot.modBinary = settings->getModBinary();
+	}
+
+	snapshot.saveCfg = !config->isReadOnly() && config->isModified();
+	if (snapshot.saveCfg)
+	{
+		snapshot.cfgPath = config->getConfigPath();
+		snapshot.cfg = config->serialize();
+	}
+	return snapshot;
+}
+
+//! Runs on a worker thread. Turning the JSON document into text is the expensive part, so it happens here too.
+bool SaveScheduler::writeSnapshot(const SaveSnapshot& snapshot)
+{
+	TRACE_SCOPE("SaveScheduler::writeSnapshot");
+
+	bool success = true;
+	if (snapshot.saveJson)
+	{
+		success &= writeFile(snapshot.jsonPath, snapshot.json.toJson());
+
+		// mods.bin is stamped with the mods.json just written, so it has to come second.
+		// Without it the next start just reads the JSON, so a failure here isn't worth retrying.
+		if (success && !snapshot.modBinary.isEmpty())
+		{
+			if (!SettingsInterface::writeBinary(snapshot.binaryPath, snapshot.jsonPath, snapshot.binaryRoot, snapshot.modBinary))
+				qWarning("Couldn't write binary settings file.");
+		}
+	}
+	if (snapshot.saveCfg)
+		success &= writeFile(snapshot.cfgPath, snapshot.cfg);
+	return success;
+}
+
+//! QSaveFile writes to a temporary file, syncs it to disk and renames it over the old one on commit.
+bool SaveScheduler::writeFile(const QString& path, const QByteArray& contents)
+{
+	QSaveFile file(path);
+	if (!file.open(QIODevice::WriteOnly))
+		return false;
+
+	if (file.write(contents) != contents.size())
+	{
+		file.cancelWriting();
+		return false;
+	}
+	return file.commit();
+}
@@ -0,0 +1,77 @@
+#ifndef SAVESCHEDULER_H
+#define SAVESCHEDULER_H
+
+#include <QByteArray>
+#include <QFutureWatcher>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+#include "OpenMWConfigInterface.h"
+#include "SettingsInterface.h"
+#include "TreeModModel.h"
+
+/** What gets written in one save, taken on the GUI thread so the worker never touches live state. */
+struct SaveSnapshot
+{
+	SaveSnapshot();
+
+	QString jsonPath;
+	QJsonDocument json;
+	int jsonRevision;
+	bool saveJson;
+
+	// mods.bin goes with mods.json, when there is a binary tree to write.
+	QString binaryPath;
+	QJsonObject binaryRoot;
+	QByteArray modBinary;
+
+	QString cfgPath;
+	QByteArray cfg;
+	bool saveCfg;
+};
+
+/**
+ * Saves mods.json and openmw.cfg in the background while the user works.
+ * Edits are coalesced: a save happens once things have been quiet for a moment, but never later
+ * than a fixed delay after the first unsaved edit. Files are replaced atomically.
+ */
+class SaveScheduler : public QObject
+{
+	Q_OBJECT
+public:
+	SaveScheduler(TreeModModel* modModel, SettingsInterface* settingsInterface, OpenMWConfigInterface* configInterface, QObject *parent = 0);
+	~SaveScheduler();
+
+	// Writes anything pending right away and waits for it, for use on exit.
+	void flush();
+
+public slots:
+	void schedule();
+
+private slots:
+	void saveInBackground();
+	void saveFinished();
+
+private:
+	SaveSnapshot takeSnapshot();
+	void markSaved(const SaveSnapshot& snapshot);
+
+	static bool writeSnapshot(const SaveSnapshot& snapshot);
+	static bool writeFile(const QString& path, const QByteArray& contents);
+
+	TreeModModel* model;
+	SettingsInterface* settings;
+	OpenMWConfigInterface* config;
+
+	QTimer quietTimer;
+	QTimer deadlineTimer;
+
+	QFutureWatcher<bool> writer;
+	SaveSnapshot runningSnapshot;
+	bool pending;
+};
+
+#endif // SAVESCHEDULER_H
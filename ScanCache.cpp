@@ -0,0 +1,169 @@
+#include "ScanCache.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+static const quint32 CACHE_MAGIC = 0x4f4d4d43; // "OMMC"
+static const quint32 CACHE_VERSION = 1;
+
+ScanDirectory::ScanDirectory()
+{
+	modified = 0;
+	inode = 0;
+}
+
+bool ScanDirectory::operator==(const ScanDirectory& other) const
+{
+	return modified == other.modified && inode == other.inode && files == other.files && subdirectories == other.subdirectories;
+}
+
+QDataStream& operator<<(QDataStream& stream, const ScanDirectory& directory)
+{
+	stream << directory.modified << directory.inode << directory.files << directory.subdirectories;
+	return stream;
+}
+
+QDataStream& operator>>(QDataStream& stream, ScanDirectory& directory)
+{
+	stream >> directory.modified >> directory.inode >> directory.files >> directory.subdirectories;
+	return stream;
+}
+
+ScanCache::ScanCache(const QString& cacheFilePath)
+{
+	cachePath = cacheFilePath;
+	readOnly = false;
+	modified = false;
+	load();
+}
+
+ScanCache::~ScanCache()
+{
+	save();
+}
+
+void ScanCache::save()
+{
+	QMutexLocker locker(&mutex);
+	if (readOnly)
+		return;
+
+	// Unless a listing changed or a folder went away, the file on disk is as good as it gets.
+	bool stale = modified;
+	for (QHash<QString, ScanDirectoryMap>::const_iterator it = folders.constBegin(); !stale && it != folders.constEnd(); ++it)
+		stale = !usedFolders.contains(it.key());
+	if (!stale)
+		return;
+
+	QSaveFile cacheFile(cachePath);
+	if (!cacheFile.open(QIODevice::WriteOnly))
+	{
+		qWarning("Couldn't open scan cache for writing.");
+		return;
+	}
+
+	// Only keep folders that were still around this session.
+	QHash<QString, ScanDirectoryMap> usedData;
+	foreach (const QString& folder, usedFolders)
+	{
+		if (folders.contains(folder))
+			usedData[folder] = folders[folder];
+	}
+
+	QDataStream stream(&cacheFile);
+	stream.setVersion(QDataStream::Qt_5_7);
+	stream << CACHE_MAGIC << CACHE_VERSION << usedData;
+
+	if (stream.status() != QDataStream::Ok || !cacheFile.commit())
+		qWarning("Couldn't write scan cache.");
+	else
+		modified = false;
+}
+
+void ScanCache::load()
+{
+	QMutexLocker locker(&mutex);
+	folders.clear();
+	usedFolders.clear();
+	modified = false;
+
+	QFile cacheFile(cachePath);
+	if (!cacheFile.open(QIODevice::ReadOnly))
+		return;
+
+	QDataStream stream(&cacheFile);
+	stream.setVersion(QDataStream::Qt_5_7);
+
+	quint32 magic, version;
+	stream >> magic >> version;
+	if (magic != CACHE_MAGIC || version != CACHE_VERSION)
+		return;
+
+	stream >> folders;
+	if (stream.status() != QDataStream::Ok)
+	{
+		qWarning("Scan cache is corrupt; folders will be rescanned.");
+		folders.clear();
+	}
+}
+
+ScanDirectoryMap ScanCache::lookup(const QString& folder)
+{
+	QMutexLocker locker(&mutex);
+	usedFolders.insert(folder);
+	return folders.value(folder);
+}
+
+void ScanCache::store(const QString& folder, const ScanDirectoryMap& directories)
+{
+	QMutexLocker locker(&mutex);
+	usedFolders.insert(folder);
+
+	// Rescanning an unchanged folder stores what is already there.
+	QHash<QString, ScanDirectoryMap>::iterator existing = folders.find(folder);
+	if (existing != folders.end() && existing.value() == directories)
+		return;
+
+	folders[folder] = directories;
+	modified = true;
+}
+
+//! For runs that must not leave anything behind on disk.
+void ScanCache::setReadOnly(bool value)
+{
+	QMutexLocker locker(&mutex);
+	readOnly = value;
+}
+
+bool ScanCache::readSignature(const QString& path, qint64& modified, quint64& inode)
+{
+#ifdef Q_OS_UNIX
+	struct stat info;
+	if (::stat(QFile::encodeName(path).constData(), &info) != 0)
+		return false;
+
+	modified = qint64(info.st_mtime) * 1000000000;
+#if defined(Q_OS_LINUX)
+	modified += info.st_mtim.tv_nsec;
+#elif defined(Q_OS_MACOS)
+	modified += info.st_mtimespec.tv_nsec;
+#endif
+	inode = quint64(info.st_ino);
+	return true;
+#else
+	QFileInfo info(path);
+	if (!info.exists())
+		return false;
+
+	modified = info.lastModified().toMSecsSinceEpoch() * 1000000;
+	inode = 0;
+	return true;
+#endif
+}
@@ -0,0 +1,56 @@
+#ifndef SCANCACHE_H
+#define SCANCACHE_H
+
+#include <QDataStream>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+/** A single directory's listing, along with the signature it had when it was listed. */
+struct ScanDirectory
+{
+	ScanDirectory();
+
+	bool operator==(const ScanDirectory& other) const;
+
+	qint64 modified;
+	quint64 inode;
+	QStringList files;
+	QStringList subdirectories;
+};
+
+// Directories of a data folder, keyed by their path relative to it. The folder itself is "".
+typedef QHash<QString, ScanDirectory> ScanDirectoryMap;
+
+QDataStream& operator<<(QDataStream& stream, const ScanDirectory& directory);
+QDataStream& operator>>(QDataStream& stream, ScanDirectory& directory);
+
+class ScanCache
+{
+public:
+	ScanCache(const QString& cacheFilePath);
+	~ScanCache();
+
+	void save();
+	void load();
+	void setReadOnly(bool value);
+
+	// These are safe to call from scanning threads.
+	ScanDirectoryMap lookup(const QString& folder);
+	void store(const QString& folder, const ScanDirectoryMap& directories);
+
+	static bool readSignature(const QString& path, qint64& modified, quint64& inode);
+
+private:
+	QString cachePath;
+
+	QMutex mutex;
+	QHash<QString, ScanDirectoryMap> folders;
+	QSet<QString> usedFolders;
+	bool readOnly;
+	bool modified;
+};
+
+#endif // SCANCACHE_H
@@ -1,18 +1,31 @@
 #include "SettingsInterface.h"
+#include "ScanCache.h"
+#include "Trace.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QVariantMap>
+
+static const quint32 BINARY_MAGIC = 0x4f4d4d42; // "OMMB"
+static const quint32 BINARY_VERSION = 1;
 
 SettingsInterface::SettingsInterface(const QString& jsonFilePath)
 {
 	jsonPath = jsonFilePath;
+	modsLoaded = false;
+	readOnly = false;
+	modified = false;
+	revision = 0;
 
-	// Load json from settings file.
-	QFile jsonFile(jsonPath);
-	if (!jsonFile.open(QIODevice::ReadOnly | QIODevice::Text))
-	{
-		qWarning("Couldn't open settings file for reading.");
+	// The mods are only parsed from JSON if mods.bin is missing or out of date.
+	if (loadBinary())
 		return;
-	}
 
-	json = QJsonDocument::fromJson(jsonFile.readAll());
+	root = readJson();
+	mods = root.take("mods").toArray();
+	modsLoaded = true;
 }
 
 SettingsInterface::~SettingsInterface()
@@ -22,41 +35,205 @@ SettingsInterface::~SettingsInterface()
 
 void SettingsInterface::save()
 {
-	QFile jsonFile(jsonPath);
+	if (readOnly || !modified)
+		return;
+
+	TRACE_SCOPE("SettingsInterface::save");
+	QSaveFile jsonFile(jsonPath);
 	if (!jsonFile.open(QIODevice::WriteOnly))
 	{
 		qWarning("Couldn't open settings file for writing.");
 		return;
 	}
 
-	jsonFile.write(json.toJson());
+	jsonFile.write(getJsonDoc().toJson());
+	if (!jsonFile.commit())
+	{
+		qWarning("Couldn't write settings file.");
+		return;
+	}
+	modified = false;
+
+	if (!modBinary.isEmpty() && !writeBinary(getBinaryPath(), jsonPath, root, modBinary))
+		qWarning("Couldn't write binary settings file.");
+}
+
+void SettingsInterface::setReadOnly(bool value)
+{
+	readOnly = value;
+}
+
+bool SettingsInterface::isReadOnly() const
+{
+	return readOnly;
+}
+
+bool SettingsInterface::isModified() const
+{
+	return modified;
+}
+
+int SettingsInterface::getRevision() const
+{
+	return revision;
+}
+
+void SettingsInterface::markSaved(int savedRevision)
+{
+	// Anything changed since then still needs saving.
+	if (savedRevision == revision)
+		modified = false;
+}
+
+QString SettingsInterface::getJsonPath() const
+{
+	return jsonPath;
 }
 
+QString SettingsInterface::getBinaryPath() const
+{
+	return QFileInfo(jsonPath).dir().filePath("mods.bin");
+}
 
 QVariant SettingsInterface::getSetting(const QString& key)
 {
-	return (QVariant) json.object()["settings"].toObject()[key];
+	return (QVariant) root.value("settings").toObject().value(key);
 }
 
 void SettingsInterface::setSetting(const QString& key, const QString& value)
 {
-	QJsonObject rootObject = json.object();
-
-	QJsonObject settingsObject = rootObject["settings"].toObject();
+	QJsonObject settingsObject = root.value("settings").toObject();
+	if (settingsObject.value(key) == QJsonValue(value))
+		return;
 	settingsObject[key] = value;
-	rootObject["settings"] = settingsObject;
+	root["settings"] = settingsObject;
+
+	modified = true;
+	revision++;
+}
+
+QString SettingsInterface::getCachePath() const
+{
+	return QFileInfo(jsonPath).dir().filePath("mods.cache");
+}
+
+QString SettingsInterface::getHashCachePath() const
+{
+	return QFileInfo(jsonPath).dir().filePath("mods.hashes");
+}
+
+QJsonDocument SettingsInterface::getJsonDoc()
+{
+	QJsonObject rootObject = root;
+	rootObject["mods"] = getModJson();
+	return QJsonDocument(rootObject);
+}
+
+QJsonObject SettingsInterface::getRootWithoutMods() const
+{
+	return root;
+}
 
-	json = QJsonDocument(rootObject);
+QJsonArray SettingsInterface::getModJson()
+{
+	// Loaded from mods.bin, and the tree hasn't been stored since: mods.json still holds the same mods.
+	if (!modsLoaded)
+	{
+		TRACE_SCOPE("SettingsInterface::getModJson");
+		mods = readJson().value("mods").toArray();
+		modsLoaded = true;
+	}
+	return mods;
 }
 
-const QJsonDocument& SettingsInterface::getJsonDoc()
+const QByteArray& SettingsInterface::getModBinary() const
 {
-	return json;
+	return modBinary;
 }
 
+//! Callers only store the tree when it changed, so this always counts as a modification.
 void SettingsInterface::setModJson(TreeModItem* rootItem)
 {
-	QJsonObject rootObject = json.object();
-	rootObject["mods"] = rootItem->toJsonObject();
-	json = QJsonDocument(rootObject);
+	mods = rootItem->toJsonObject().toArray();
+	modsLoaded = true;
+
+	modBinary.clear();
+	QDataStream stream(&modBinary, QIODevice::WriteOnly);
+	stream.setVersion(QDataStream::Qt_5_7);
+	rootItem->writeChildren(stream);
+
+	modified = true;
+	revision++;
+}
+
+//! Written after mods.json, and stamped with its size, modification time and inode.
+bool SettingsInterface::writeBinary(const QString& binaryPath, const QString& jsonPath, const QJsonObject& rootWithoutMods, const QByteArray& modBinary)
+{
+	TRACE_SCOPE("SettingsInterface::writeBinary");
+	qint64 jsonModified;
+	quint64 jsonInode;
+	if (!ScanCache::readSignature(jsonPath, jsonModified, jsonInode))
+		return false;
+
+	QSaveFile binaryFile(binaryPath);
+	if (!binaryFile.open(QIODevice::WriteOnly))
+		return false;
+
+	QDataStream stream(&binaryFile);
+	stream.setVersion(QDataStream::Qt_5_7);
+	stream << BINARY_MAGIC << BINARY_VERSION;
+	stream << QFileInfo(jsonPath).size() << jsonModified << jsonInode;
+	stream << rootWithoutMods.toVariantMap() << modBinary;
+
+	return stream.status() == QDataStream::Ok && binaryFile.commit();
+}
+
+bool SettingsInterface::loadBinary()
+{
+	TRACE_SCOPE("SettingsInterface::loadBinary");
+	QFile binaryFile(getBinaryPath());
+	if (!binaryFile.open(QIODevice::ReadOnly))
+		return false;
+
+	QDataStream stream(&binaryFile);
+	stream.setVersion(QDataStream::Qt_5_7);
+
+	quint32 magic, version;
+	stream >> magic >> version;
+	if (magic != BINARY_MAGIC || version != BINARY_VERSION)
+		return false;
+
+	// Anything done to mods.json since, by hand or by another tool, makes it the one to trust.
+	qint64 jsonSize, jsonModified, currentModified;
+	quint64 jsonInode, currentInode;
+	stream >> jsonSize >> jsonModified >> jsonInode;
+	if (!ScanCache::readSignature(jsonPath, currentModified, currentInode))
+		return false;
+	if (jsonSize != QFileInfo(jsonPath).size() || jsonModified != currentModified || jsonInode != currentInode)
+		return false;
+
+	QVariantMap rootMap;
+	stream >> rootMap >> modBinary;
+	if (stream.status() != QDataStream::Ok)
+	{
+		qWarning("Binary settings file is corrupt; loading mods.json instead.");
+		modBinary.clear();
+		return false;
+	}
+
+	root = QJsonObject::fromVariantMap(rootMap);
+	return true;
+}
+
+QJsonObject SettingsInterface::readJson() const
+{
+	TRACE_SCOPE("SettingsInterface::readJson");
+	QFile jsonFile(jsonPath);
+	if (!jsonFile.open(QIODevice::ReadOnly | QIODevice::Text))
+	{
+		qWarning("Couldn't open settings file for reading.");
+		return QJsonObject();
+	}
+
+	return QJsonDocument::fromJson(jsonFile.readAll()).object();
 }
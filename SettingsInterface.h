@@ -1,13 +1,19 @@
 #ifndef SETTINGSINTERFACE_H
 #define SETTINGSINTERFACE_H
 
+#include <QByteArray>
 #include <QFile>
+#include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QString>
 
 #include "TreeModItem.h"
 
+/**
+ * mods.json, plus mods.bin: the same tree in a compact binary form that loads without parsing JSON.
+ * mods.bin is only trusted while mods.json is the file it was written next to; JSON stays the format to edit and share.
+ */
 class SettingsInterface
 {
 public:
@@ -15,16 +21,46 @@ public:
 	~SettingsInterface();
 
 	void save();
+	void setReadOnly(bool value);
+	bool isReadOnly() const;
+
+	// For saving elsewhere: write out getJsonDoc() and getModBinary(), then report which revision was written.
+	bool isModified() const;
+	int getRevision() const;
+	void markSaved(int savedRevision);
+	QString getJsonPath() const;
+	QString getBinaryPath() const;
 
 	QVariant getSetting(const QString& key);
 	void setSetting(const QString& key, const QString& value);
 
-	const QJsonDocument& getJsonDoc();
+	QString getCachePath() const;
+	QString getHashCachePath() const;
+
+	QJsonDocument getJsonDoc();
+	QJsonObject getRootWithoutMods() const;
+	QJsonArray getModJson();
+	// Empty unless the tree came from mods.bin or has been stored since.
+	const QByteArray& getModBinary() const;
 	void setModJson(TreeModItem* rootItem);
 
+	static bool writeBinary(const QString& binaryPath, const QString& jsonPath, const QJsonObject& rootWithoutMods, const QByteArray& modBinary);
+
 private:
+	bool loadBinary();
+	QJsonObject readJson() const;
+
 	QString jsonPath;
-	QJsonDocument json;
+
+	// Everything in mods.json but the mods, which are kept apart so settings changes don't copy the tree.
+	QJsonObject root;
+	QJsonArray mods;
+	bool modsLoaded;
+	QByteArray modBinary;
+
+	bool readOnly;
+	bool modified;
+	int revision;
 };
 
 #endif // SETTINGSINTERFACE_H
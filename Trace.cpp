@@ -0,0 +1,111 @@
+#include "Trace.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QThread>
+#include <QVector>
+
+namespace
+{
+	struct TraceEvent
+	{
+		const char* name;
+		qint64 start;
+		qint64 duration;
+		int thread;
+	};
+
+	QElapsedTimer clock;
+	QString outputPath;
+
+	// Guarded by mutex.
+	QMutex mutex;
+	QVector<TraceEvent> events;
+	QHash<Qt::HANDLE, int> threadIds;
+}
+
+bool Trace::enabled = false;
+
+void Trace::enable(const QString& path)
+{
+	if (path.isEmpty())
+		return;
+
+	outputPath = path;
+	clock.start();
+	enabled = true;
+}
+
+void Trace::enableFromEnvironment()
+{
+	QString path = QString::fromLocal8Bit(qgetenv("OPENMWMM_TRACE"));
+	if (!path.isEmpty())
+		enable(path);
+}
+
+//! Microseconds since tracing was enabled, which is what trace events are measured in.
+qint64 Trace::now()
+{
+	return clock.nsecsElapsed() / 1000;
+}
+
+void Trace::record(const char* name, qint64 start, qint64 end)
+{
+	Qt::HANDLE thread = QThread::currentThreadId();
+
+	QMutexLocker locker(&mutex);
+
+	// Small thread numbers read better than raw handles; the first thread to trace gets 1.
+	QHash<Qt::HANDLE, int>::const_iterator it = threadIds.constFind(thread);
+	int threadId = it != threadIds.constEnd() ? it.value() : threadIds.size() + 1;
+	if (it == threadIds.constEnd())
+		threadIds.insert(thread, threadId);
+
+	TraceEvent event;
+	event.name = name;
+	event.start = start;
+	event.duration = end - start;
+	event.thread = threadId;
+	events.push_back(event);
+}
+
+bool Trace::flush()
+{
+	if (!enabled)
+		return true;
+
+	QMutexLocker locker(&mutex);
+
+	QSaveFile file(outputPath);
+	if (!file.open(QIODevice::WriteOnly))
+	{
+		qWarning("Couldn't open trace file for writing.");
+		return false;
+	}
+
+	QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+	QByteArray json = "{\"traceEvents\":[\n";
+	for (int i = 0; i < events.size(); i++)
+	{
+		const TraceEvent& event = events[i];
+		json += "{\"name\":\"";
+		json += event.name;
+		json += "\",\"ph\":\"X\",\"ts\":";
+		json += QByteArray::number(event.start);
+		json += ",\"dur\":";
+		json += QByteArray::number(event.duration);
+		json += ",\"pid\":";
+		json += pid;
+		json += ",\"tid\":";
+		json += QByteArray::number(event.thread);
+		json += i + 1 < events.size() ? "},\n" : "}\n";
+	}
+	json += "],\"displayTimeUnit\":\"ms\"}\n";
+
+	file.write(json);
+	return file.commit();
+}
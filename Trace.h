@@ -0,0 +1,56 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QString>
+
+/**
+ * Scoped spans written out as Chrome trace-event JSON, for chrome://tracing or Perfetto.
+ * Tracing is turned on once at startup; when it's off a span costs a single branch.
+ */
+class Trace
+{
+public:
+	// Call these before any other thread is started.
+	static void enable(const QString& outputPath);
+	static void enableFromEnvironment();
+
+	static bool isEnabled()
+	{
+		return enabled;
+	}
+
+	static qint64 now();
+	static void record(const char* name, qint64 start, qint64 end);
+	static bool flush();
+
+private:
+	static bool enabled;
+};
+
+class TraceSpan
+{
+public:
+	explicit TraceSpan(const char* spanName)
+	{
+		name = spanName;
+		start = Trace::isEnabled() ? Trace::now() : 0;
+	}
+
+	~TraceSpan()
+	{
+		if (Trace::isEnabled())
+			Trace::record(name, start, Trace::now());
+	}
+
+private:
+	const char* name;
+	qint64 start;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+// Times the rest of the enclosing scope. The name must be a string literal.
+#define TRACE_SCOPE(name) TraceSpan TRACE_CONCAT(traceSpan, __LINE__)(name)
+
+#endif // TRACE_H
@@ -1,11 +1,25 @@
 #include "TreeModItem.h"
 
+#include <QDataStream>
 #include <QStringList>
 
-TreeModItem::TreeModItem(const QVector<QVariant> &data, TreeModItem *parent)
+// Items are carved out of blocks of this many and recycled through a free list.
+// The tree only lives on the GUI thread, so the pool isn't locked.
+static const int POOL_BLOCK_ITEMS = 1024;
+
+struct FreeItem
+{
+	FreeItem* next;
+};
+
+static FreeItem* freeItems = 0;
+
+TreeModItem::TreeModItem(TreeModItem *parent)
 {
 	parentItem = parent;
-	itemData = data;
+	row = 0;
+	enabled = false;
+	conflictState = CONFLICT_NONE;
 }
 
 TreeModItem::~TreeModItem()
@@ -13,6 +27,44 @@ TreeModItem::~TreeModItem()
 	qDeleteAll(childItems);
 }
 
+void* TreeModItem::operator new(std::size_t size)
+{
+	if (size != sizeof(TreeModItem))
+		return ::operator new(size);
+
+	if (!freeItems)
+	{
+		char* block = static_cast<char*>(::operator new(sizeof(TreeModItem) * POOL_BLOCK_ITEMS));
+		for (int i = POOL_BLOCK_ITEMS - 1; i >= 0; i--)
+		{
+			FreeItem* item = reinterpret_cast<FreeItem*>(block + sizeof(TreeModItem) * i);
+			item->next = freeItems;
+			freeItems = item;
+		}
+	}
+
+	FreeItem* item = freeItems;
+	freeItems = item->next;
+	return item;
+}
+
+//! Blocks are never handed back; a tree that grew once tends to grow again.
+void TreeModItem::operator delete(void* pointer, std::size_t size)
+{
+	if (!pointer)
+		return;
+
+	if (size != sizeof(TreeModItem))
+	{
+		::operator delete(pointer);
+		return;
+	}
+
+	FreeItem* item = static_cast<FreeItem*>(pointer);
+	item->next = freeItems;
+	freeItems = item;
+}
+
 TreeModItem *TreeModItem::child(int number)
 {
 	return childItems.value(number);
@@ -25,46 +77,50 @@ int TreeModItem::childCount() const
 
 int TreeModItem::childNumber() const
 {
-	if (parentItem)
-		return parentItem->childItems.indexOf(const_cast<TreeModItem*>(this));
-
-	return 0;
+	return row;
 }
 
-int TreeModItem::columnCount() const
+QVariant TreeModItem::data(int column) const
 {
-	return itemData.count();
+	switch (column)
+	{
+	case COLUMN_INDEX:
+		return row;
+	case COLUMN_NAME:
+		return name;
+	case COLUMN_FOLDER:
+		return folder;
+	case COLUMN_ENABLED:
+		return enabled;
+	default:
+		return QVariant();
+	}
 }
 
-QVariant TreeModItem::data(int column) const
+const QString& TreeModItem::getName() const
 {
-	return itemData.value(column);
+	return name;
 }
 
-bool TreeModItem::insertChildren(int position, int count, int columns)
+const QString& TreeModItem::getFolder() const
 {
-	if (position < 0 || position > childItems.size())
-		return false;
-
-	for (int row = 0; row < count; ++row) {
-		QVector<QVariant> data(columns);
-		TreeModItem *item = new TreeModItem(data, this);
-		childItems.insert(position, item);
-	}
+	return folder;
+}
 
-	return true;
+bool TreeModItem::isEnabled() const
+{
+	return enabled;
 }
 
-bool TreeModItem::insertColumns(int position, int columns)
+bool TreeModItem::insertChildren(int position, int count)
 {
-	if (position < 0 || position > itemData.size())
+	if (position < 0 || position > childItems.size())
 		return false;
 
-	for (int column = 0; column < columns; ++column)
-		itemData.insert(position, QVariant());
-
-	foreach (TreeModItem *child, childItems)
-		child->insertColumns(position, columns);
+	childItems.insert(position, count, 0);
+	for (int i = position; i < position + count; ++i)
+		childItems[i] = new TreeModItem(this);
+	updateRows(position);
 
 	return true;
 }
@@ -76,42 +132,129 @@ TreeModItem *TreeModItem::parent()
 
 bool TreeModItem::removeChildren(int position, int count)
 {
-	if (position < 0 || position + count > childItems.size())
+	if (position < 0 || count < 0 || position + count > childItems.size())
 		return false;
 
-	for (int row = 0; row < count; ++row)
-		delete childItems.takeAt(position);
+	for (int i = position; i < position + count; ++i)
+		delete childItems[i];
+	childItems.remove(position, count);
+	updateRows(position);
 
 	return true;
 }
 
-bool TreeModItem::removeColumns(int position, int columns)
+TreeModItem* TreeModItem::appendChild(const QString& name, const QString& folder, bool enabled)
 {
-	if (position < 0 || position + columns > itemData.size())
-		return false;
+	TreeModItem* item = new TreeModItem(this);
+	item->row = childItems.size();
+	item->name = name;
+	item->folder = folder;
+	item->enabled = enabled;
+	childItems.push_back(item);
+	return item;
+}
 
-	for (int column = 0; column < columns; ++column)
-		itemData.remove(position);
+void TreeModItem::addChildrenFromJson(const QJsonArray& array)
+{
+	foreach (const QJsonValue& value, array)
+	{
+		QJsonObject obj = value.toObject();
+		TreeModItem* item = appendChild(obj["name"].toString(), obj["folder"].toString(), obj["enabled"].toBool());
+		item->addChildrenFromJson(obj["mods"].toArray());
+	}
+}
 
-	foreach (TreeModItem *child, childItems)
-		child->removeColumns(position, columns);
+//! Moves every child of source in here, starting at position. Source is left without children.
+void TreeModItem::adoptChildren(int position, TreeModItem* source)
+{
+	int count = source->childItems.size();
+	childItems.insert(position, count, 0);
+	for (int i = 0; i < count; i++)
+	{
+		TreeModItem* item = source->childItems[i];
+		item->parentItem = this;
+		childItems[position + i] = item;
+	}
+	source->childItems.clear();
+	updateRows(position);
+}
 
-	return true;
+//! Relinks existing items. destinationChild counts rows as they were before the move, like QAbstractItemModel::moveRows.
+void TreeModItem::moveChildren(int position, int count, TreeModItem* destination, int destinationChild)
+{
+	QVector<TreeModItem*> moved = childItems.mid(position, count);
+	childItems.remove(position, count);
+	if (destination == this && destinationChild > position)
+		destinationChild -= count;
+
+	destination->childItems.insert(destinationChild, count, 0);
+	for (int i = 0; i < count; i++)
+	{
+		moved[i]->parentItem = destination;
+		destination->childItems[destinationChild + i] = moved[i];
+	}
+
+	updateRows(destination == this ? qMin(position, destinationChild) : position);
+	if (destination != this)
+		destination->updateRows(destinationChild);
 }
 
+//! Keeps the cached rows of the children from startAt onwards in step with their positions.
+void TreeModItem::updateRows(int startAt)
+{
+	for (int i = startAt; i < childItems.size(); i++)
+		childItems[i]->row = i;
+}
+
+//! The index column is always the row, so setting it only has to succeed.
 bool TreeModItem::setData(int column, const QVariant &value)
 {
-	if (column < 0 || column >= itemData.size())
+	switch (column)
+	{
+	case COLUMN_INDEX:
+		return true;
+	case COLUMN_NAME:
+		name = value.toString();
+		return true;
+	case COLUMN_FOLDER:
+		folder = value.toString();
+		return true;
+	case COLUMN_ENABLED:
+		enabled = value.toBool();
+		return true;
+	default:
 		return false;
+	}
+}
+
+bool TreeModItem::isBefore(const TreeModItem* other) const
+{
+	// Compare row paths from the root. Parents are loaded before their children.
+	QVector<int> path;
+	for (const TreeModItem* item = this; item->parentItem; item = item->parentItem)
+		path.prepend(item->row);
 
-//	if (column == TreeModItem::COLUMN_ENABLED)
-//	{
-//		itemData[column] = value.toBool() ? Qt::Checked : Qt::Unchecked;
-//		return true;
-//	}
+	QVector<int> otherPath;
+	for (const TreeModItem* item = other; item->parentItem; item = item->parentItem)
+		otherPath.prepend(item->row);
 
-	itemData[column] = value;
-	return true;
+	for (int i = 0; i < path.size() && i < otherPath.size(); i++)
+	{
+		if (path[i] != otherPath[i])
+			return path[i] < otherPath[i];
+	}
+
+	return path.size() < otherPath.size();
+}
+
+TreeModItem::ConflictState TreeModItem::getConflictState() const
+{
+	return conflictState;
+}
+
+void TreeModItem::setConflictState(ConflictState state)
+{
+	conflictState = state;
 }
 
 QJsonArray TreeModItem::getChildrenAsJsonArray()
@@ -120,7 +263,7 @@ QJsonArray TreeModItem::getChildrenAsJsonArray()
 
 	foreach (TreeModItem *child, childItems)
 	{
-		array.insert(child->childNumber(), child->toJsonObject());
+		array.append(child->toJsonObject());
 	}
 
 	return array;
@@ -134,9 +277,9 @@ QJsonValue TreeModItem::toJsonObject()
 	}
 
 	QJsonObject obj;
-	obj["name"] = data(1).toString();
-	obj["folder"] = data(2).toString();
-	obj["enabled"] = data(3).toBool();
+	obj["name"] = name;
+	obj["folder"] = folder;
+	obj["enabled"] = enabled;
 	if (childCount() > 0)
 		obj["mods"] = getChildrenAsJsonArray();
 	return obj;
@@ -146,13 +289,7 @@ void TreeModItem::serialize(QDataStream& stream)
 {
 	// Store base data.
 	for (int column = 0; column < TreeModItem::COLUMN_COUNT; column++)
-	{
-		Qt::ItemDataRole role = Qt::DisplayRole;
-		if (column == TreeModItem::COLUMN_ENABLED)
-			role = Qt::CheckStateRole;
-
 		stream << this->data(column);
-	}
 
 	// Store children.
 	stream << QVariant(this->childCount());
@@ -164,11 +301,44 @@ void TreeModItem::serialize(QDataStream& stream)
 
 void TreeModItem::serialize(QVector<QVariant>& dataVect)
 {
-	if (data(COLUMN_ENABLED).toBool())
+	// The root has no check box of its own.
+	if (enabled || !parentItem)
 	{
 		if (parentItem)
-			dataVect.push_back(data(COLUMN_FOLDER));
+			dataVect.push_back(folder);
 		foreach (TreeModItem* child, childItems)
 			child->serialize(dataVect);
 	}
 }
+
+void TreeModItem::writeChildren(QDataStream& stream) const
+{
+	stream << qint32(childItems.size());
+	foreach (const TreeModItem* child, childItems)
+	{
+		stream << child->name << child->folder << child->enabled;
+		child->writeChildren(stream);
+	}
+}
+
+//! Items go straight into the tree. On failure, whatever was read so far is left for the caller to remove.
+bool TreeModItem::readChildren(QDataStream& stream)
+{
+	qint32 count;
+	stream >> count;
+	if (stream.status() != QDataStream::Ok || count < 0)
+		return false;
+
+	for (int i = 0; i < count; i++)
+	{
+		TreeModItem* item = new TreeModItem(this);
+		item->row = childItems.size();
+		childItems.push_back(item);
+
+		stream >> item->name >> item->folder >> item->enabled;
+		if (stream.status() != QDataStream::Ok || !item->readChildren(stream))
+			return false;
+	}
+
+	return true;
+}
@@ -3,33 +3,51 @@
 
 #include <QJsonArray>
 #include <QJsonObject>
-#include <QList>
+#include <QString>
 #include <QVariant>
 #include <QVector>
 
+#include <cstddef>
+
+/**
+ * One row of the mod tree. The columns are fixed, so they are plain fields, and each item knows its own row.
+ * Items come from a pool rather than one heap allocation each, since big trees have a lot of them.
+ */
 class TreeModItem
 {
 public:
-	explicit TreeModItem(const QVector<QVariant> &data, TreeModItem *parent = 0);
+	explicit TreeModItem(TreeModItem *parent = 0);
 	~TreeModItem();
 
 	TreeModItem *child(int number);
 	int childCount() const;
-	int columnCount() const;
 	QVariant data(int column) const;
-	bool insertChildren(int position, int count, int columns);
-	bool insertColumns(int position, int columns);
+	bool insertChildren(int position, int count);
 	TreeModItem *parent();
 	bool removeChildren(int position, int count);
-	bool removeColumns(int position, int columns);
+	void moveChildren(int position, int count, TreeModItem* destination, int destinationChild);
 	int childNumber() const;
 	bool setData(int column, const QVariant &value);
+	bool isBefore(const TreeModItem* other) const;
+
+	// For building subtrees away from the model, to be inserted in one go.
+	TreeModItem* appendChild(const QString& name, const QString& folder, bool enabled);
+	void addChildrenFromJson(const QJsonArray& array);
+	void adoptChildren(int position, TreeModItem* source);
+
+	const QString& getName() const;
+	const QString& getFolder() const;
+	bool isEnabled() const;
 
 	QJsonArray getChildrenAsJsonArray();
 	QJsonValue toJsonObject();
 	void serialize(QDataStream& stream);
 	void serialize(QVector<QVariant>& dataVect);
 
+	// The subtree in preorder, as stored in mods.bin.
+	void writeChildren(QDataStream& stream) const;
+	bool readChildren(QDataStream& stream);
+
 	enum Columns {
 		COLUMN_INDEX,
 		COLUMN_NAME,
@@ -38,13 +56,32 @@ public:
 		COLUMN_COUNT
 	};
 
+	// How this item relates to the currently selected one.
+	enum ConflictState {
+		CONFLICT_NONE,
+		CONFLICT_OVERRIDDEN,
+		CONFLICT_OVERRIDES
+	};
+
+	ConflictState getConflictState() const;
+	void setConflictState(ConflictState state);
+
+	static void* operator new(std::size_t size);
+	static void operator delete(void* pointer, std::size_t size);
+
 private:
+	void updateRows(int startAt);
+
 	// Parents & Children
-	QList<TreeModItem*> childItems;
+	QVector<TreeModItem*> childItems;
 	TreeModItem *parentItem;
+	int row;
 
 	// Data
-	QVector<QVariant> itemData;
+	QString name;
+	QString folder;
+	bool enabled;
+	ConflictState conflictState;
 };
 
 #endif // TREEMODITEM_H
@@ -0,0 +1,33 @@
+#include "TreeModMimeData.h"
+
+#include <QSet>
+
+TreeModMimeData::TreeModMimeData(const QAbstractItemModel* sourceModel, const QModelIndexList& indexes)
+{
+	model = sourceModel;
+
+	QSet<QModelIndex> dragged;
+	foreach (const QModelIndex& index, indexes)
+		dragged.insert(index.sibling(index.row(), 0));
+
+	foreach (const QModelIndex& index, indexes)
+	{
+		QModelIndex row = index.sibling(index.row(), 0);
+		bool nested = false;
+		for (QModelIndex ancestor = row.parent(); ancestor.isValid() && !nested; ancestor = ancestor.parent())
+			nested = dragged.contains(ancestor);
+
+		if (!nested && !rows.contains(row))
+			rows.push_back(row);
+	}
+}
+
+const QAbstractItemModel* TreeModMimeData::getModel() const
+{
+	return model;
+}
+
+const QList<QPersistentModelIndex>& TreeModMimeData::getIndexes() const
+{
+	return rows;
+}
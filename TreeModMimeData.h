@@ -0,0 +1,28 @@
+#ifndef TREEMODMIMEDATA_H
+#define TREEMODMIMEDATA_H
+
+#include <QAbstractItemModel>
+#include <QList>
+#include <QMimeData>
+#include <QPersistentModelIndex>
+
+/**
+ * Drag data for rows of the mod tree. Within the same model, the dragged rows are known by persistent index,
+ * so a drop can move the existing items. The serialized rows are still there for drops anywhere else.
+ */
+class TreeModMimeData : public QMimeData
+{
+	Q_OBJECT
+public:
+	TreeModMimeData(const QAbstractItemModel* sourceModel, const QModelIndexList& indexes);
+
+	const QAbstractItemModel* getModel() const;
+	// Dragged rows in order, leaving out any whose ancestor is being dragged too.
+	const QList<QPersistentModelIndex>& getIndexes() const;
+
+private:
+	const QAbstractItemModel* model;
+	QList<QPersistentModelIndex> rows;
+};
+
+#endif // TREEMODMIMEDATA_H
@@ -1,23 +1,67 @@
 #include "TreeModModel.h"
+#include "BsaArchive.h"
+#include "TreeModMimeData.h"
+#include "Trace.h"
 
 #include <QtWidgets>
 
+#include <algorithm>
+
 TreeModModel::TreeModModel(SettingsInterface* settingsInterface, OpenMWConfigInterface* configInterface, QObject *parent)
 	: QAbstractItemModel(parent)
 {
 	settings = settingsInterface;
 	config = configInterface;
 
-	QVector<QVariant> rootData;
-	rootData << tr("Index") << tr("Mod") << tr("Folder") << tr("Enabled");
-
-	rootItem = new TreeModItem(rootData);
-
-	loadDataFromJson();
+	headers << tr("Index") << tr("Mod") << tr("Folder") << tr("Enabled");
+	rootItem = new TreeModItem();
+
+	// Folders are scanned for conflicts in the background. Unchanged directories come from the cache.
+	cache = new ScanCache(settings->getCachePath());
+	scanner = new FolderScanner(this);
+	scanner->setCache(cache);
+	connect(scanner, SIGNAL(folderScanned(QString,QStringList)),
+			this, SLOT(mergeFolderScan(QString,QStringList)));
+	// Content files and archives are looked up in the index, so they can only be found once it's complete.
+	connect(scanner, SIGNAL(finished()),
+			this, SLOT(refreshDataFiles()));
+
+	// Scanned folders are then kept up to date as files change on disk.
+	watcher = new FolderWatcher(cache, this);
+	connect(watcher, SIGNAL(filesChanged(QString,QStringList,QStringList)),
+			this, SLOT(mergeFolderChanges(QString,QStringList,QStringList)));
+
+	conflictRefreshTimer.setSingleShot(true);
+	conflictRefreshTimer.setInterval(200);
+	connect(&conflictRefreshTimer, SIGNAL(timeout()),
+			this, SLOT(refreshConflictSelection()));
+
+	// Conflicting files are hashed once scans settle down, if the user asked for it.
+	hasher = new ContentHasher(settings->getHashCachePath(), this);
+	connect(hasher, SIGNAL(hashed(QVector<ContentHashJob>,QVector<quint64>)),
+			this, SLOT(mergeHashes(QVector<ContentHashJob>,QVector<quint64>)));
+	hashTimer.setSingleShot(true);
+	hashTimer.setInterval(1000);
+	connect(&hashTimer, SIGNAL(timeout()),
+			this, SLOT(hashConflicts()));
+	hashContents = settings->getSetting("hashContents").toString() == "true";
+	conflicts.setIgnoreIdentical(hashContents && settings->getSetting("hideIdentical").toString() == "true");
+
+	modsChanged = false;
+	loadData();
+	updateLoadOrder();
+	if (scanner->isIdle())
+		refreshDataFiles();
 }
 
 TreeModModel::~TreeModModel()
 {
+	// Stop scanning and watching before the cache they use goes away.
+	delete scanner;
+	delete watcher;
+	delete cache;
+	delete hasher;
+
 	saveDataToJson();
 	saveDataToConfig();
 	delete rootItem;
@@ -25,7 +69,7 @@ TreeModModel::~TreeModModel()
 
 int TreeModModel::columnCount(const QModelIndex & /* parent */) const
 {
-	return rootItem->columnCount();
+	return TreeModItem::COLUMN_COUNT;
 }
 
 QVariant TreeModModel::data(const QModelIndex &index, int role) const
@@ -35,12 +79,24 @@ QVariant TreeModModel::data(const QModelIndex &index, int role) const
 
 	if (role == Qt::TextColorRole)
 	{
-		foreach (const QModelIndex& conflict, currentConflicts)
+		switch (getItem(index)->getConflictState())
 		{
-			if (conflict == index.sibling(index.row(),0))
-				return QVariant(QColor(255, 0, 0));
+		case TreeModItem::CONFLICT_OVERRIDES:
+			return QVariant(QColor(255, 0, 0));
+		case TreeModItem::CONFLICT_OVERRIDDEN:
+			return QVariant(QColor(0, 0, 192));
+		default:
+			break;
 		}
+	}
 
+	if (role == Qt::ToolTipRole)
+	{
+		int lost = filesLost(index);
+		int won = filesWon(index);
+		if (won > 0 || lost > 0)
+			return tr("Wins %1 conflicting files, loses %2.").arg(won).arg(lost);
+		return QVariant();
 	}
 
 	if (role == Qt::DisplayRole || role == Qt::EditRole)
@@ -52,7 +108,7 @@ QVariant TreeModModel::data(const QModelIndex &index, int role) const
 	}
 	else if (role == Qt::CheckStateRole && index.column() == TreeModItem::COLUMN_ENABLED)
 	{
-		return getItem(index)->data(index.column()).toBool() ? Qt::Checked : Qt::Unchecked;
+		return getItem(index)->isEnabled() ? Qt::Checked : Qt::Unchecked;
 	}
 
 	return QVariant();
@@ -93,7 +149,7 @@ TreeModItem *TreeModModel::getItem(const QModelIndex &index) const
 QVariant TreeModModel::headerData(int section, Qt::Orientation orientation, int role) const
 {
 	if (orientation == Qt::Horizontal && role == Qt::DisplayRole)
-		return rootItem->data(section);
+		return headers.value(section);
 
 	return QVariant();
 }
@@ -111,15 +167,13 @@ QModelIndex TreeModModel::index(int row, int column, const QModelIndex &parent)
 		return QModelIndex();
 }
 
+//! The columns are fixed fields of TreeModItem.
 bool TreeModModel::insertColumns(int position, int columns, const QModelIndex &parent)
 {
-	bool success;
-
-	beginInsertColumns(parent, position, position + columns - 1);
-	success = rootItem->insertColumns(position, columns);
-	endInsertColumns();
-
-	return success;
+	Q_UNUSED(position);
+	Q_UNUSED(columns);
+	Q_UNUSED(parent);
+	return false;
 }
 
 bool TreeModModel::insertRows(int position, int rows, const QModelIndex &parent)
@@ -128,11 +182,11 @@ bool TreeModModel::insertRows(int position, int rows, const QModelIndex &parent)
 	bool success;
 
 	beginInsertRows(parent, position, position + rows - 1);
-	success = parentItem->insertChildren(position, rows, rootItem->columnCount());
+	success = parentItem->insertChildren(position, rows);
 	endInsertRows();
 
-	// Redo indexing
-	recalculateIndexes(parentItem, position);
+	modsChanged = true;
+	emit modified();
 
 	return success;
 }
@@ -153,24 +207,19 @@ QModelIndex TreeModModel::parent(const QModelIndex &index) const
 
 QModelIndex TreeModModel::getIndexForFolder(const QString& folder)
 {
-	QModelIndexList matches = this->match(this->index(0, TreeModItem::COLUMN_FOLDER), Qt::DisplayRole, QVariant::fromValue(folder), 1, Qt::MatchCaseSensitive | Qt::MatchRecursive);
-	if (matches.count() > 0)
-		return matches.first();
-	return QModelIndex();
+	TreeModItem* item = getItemForFolder(folder);
+	if (!item)
+		return QModelIndex();
+
+	return createIndex(item->childNumber(), TreeModItem::COLUMN_FOLDER, item);
 }
 
 bool TreeModModel::removeColumns(int position, int columns, const QModelIndex &parent)
 {
-	bool success;
-
-	beginRemoveColumns(parent, position, position + columns - 1);
-	success = rootItem->removeColumns(position, columns);
-	endRemoveColumns();
-
-	if (rootItem->columnCount() == 0)
-		removeRows(0, rowCount());
-
-	return success;
+	Q_UNUSED(position);
+	Q_UNUSED(columns);
+	Q_UNUSED(parent);
+	return false;
 }
 
 bool TreeModModel::removeRows(int position, int rows, const QModelIndex &parent)
@@ -178,45 +227,56 @@ bool TreeModModel::removeRows(int position, int rows, const QModelIndex &parent)
 	TreeModItem* parentItem = getItem(parent);
 	bool success = true;
 
+	// Forget about the folders of every removed row, including sub-components.
 	for (int r = 0; r < rows; r++)
 	{
-		QString folder = parent.child(position+r, TreeModItem::COLUMN_FOLDER).data().toString();
-		foreach(const QString& key, folderConflicts.keys())
-		{
-			if (folderConflicts[key].contains(folder))
-				folderConflicts.remove(folder);
-			if (folderConflicts[key].isEmpty())
-				folderConflicts.remove(key);
-		}
+		TreeModItem* item = parentItem->child(position + r);
+		if (item)
+			unregisterItem(item);
 	}
-//	if (index.column() == TreeModItem::COLUMN_FOLDER)
-//	{
-//		QString oldFolder = parent.child(row)
-//		QString newFolder = value.toString();
-
-//		// Remove all references to the old folder.
-//		foreach(const QString& key, folderConflicts)
-//		{
-//			if (folderConflicts[key].contains(oldFolder))
-//				folderConflicts.remove(oldFolder);
-//			if (folderConflicts[key].isEmpty())
-//				folderConflicts.remove(key);
-//		}
-//	}
+
+	// Clear conflicts; another selection is going to come right after.
+	clearConflictHighlights();
 
 	beginRemoveRows(parent, position, position + rows - 1);
 	success = parentItem->removeChildren(position, rows);
 	endRemoveRows();
 
-	// Redo indexing
-	recalculateIndexes(parentItem, position);
-
-	// Clear conflicts; another selection is going to come right after.
-	currentConflicts.clear();
+	updateLoadOrder();
+	modsChanged = true;
+	emit modified();
 
 	return success;
 }
 
+//! Moves the existing items, so their persistent indexes, folders and scan results all stay as they are.
+bool TreeModModel::moveRows(const QModelIndex &sourceParent, int sourceRow, int count, const QModelIndex &destinationParent, int destinationChild)
+{
+	TRACE_SCOPE("TreeModModel::moveRows");
+	TreeModItem* source = getItem(sourceParent);
+	TreeModItem* destination = getItem(destinationParent);
+	if (count <= 0 || sourceRow < 0 || sourceRow + count > source->childCount() ||
+		destinationChild < 0 || destinationChild > destination->childCount())
+		return false;
+
+	// Nothing can be moved in under itself.
+	for (TreeModItem* ancestor = destination; ancestor; ancestor = ancestor->parent())
+	{
+		if (ancestor->parent() == source && ancestor->childNumber() >= sourceRow && ancestor->childNumber() < sourceRow + count)
+			return false;
+	}
+
+	if (!beginMoveRows(sourceParent, sourceRow, sourceRow + count - 1, destinationParent, destinationChild))
+		return false;
+	source->moveChildren(sourceRow, count, destination, destinationChild);
+	endMoveRows();
+
+	updateLoadOrder();
+	modsChanged = true;
+	emit modified();
+	return true;
+}
+
 int TreeModModel::rowCount(const QModelIndex &parent) const
 {
 	return getItem(parent)->childCount();
@@ -226,7 +286,14 @@ bool TreeModModel::setData(const QModelIndex &index, const QVariant &value, int
 {
 	if (role == Qt::CheckStateRole && index.column() == TreeModItem::COLUMN_ENABLED)
 	{
-		return getItem(index)->setData(index.column(), value.toBool() ? Qt::Checked : Qt::Unchecked);
+		bool result = getItem(index)->setData(index.column(), value.toBool() ? Qt::Checked : Qt::Unchecked);
+		if (result)
+		{
+			updateLoadOrder();
+			modsChanged = true;
+			emit modified();
+		}
+		return result;
 	}
 
 	if (role != Qt::EditRole)
@@ -234,29 +301,10 @@ bool TreeModModel::setData(const QModelIndex &index, const QVariant &value, int
 
 	if (index.column() == TreeModItem::COLUMN_FOLDER)
 	{
-		QString oldFolder = index.data().toString();
-		QString newFolder = value.toString();
-
-		// Remove all references to the old folder.
-		foreach(const QString& key, folderConflicts.keys())
-		{
-			if (folderConflicts[key].contains(oldFolder))
-				folderConflicts.remove(oldFolder);
-			if (folderConflicts[key].isEmpty())
-				folderConflicts.remove(key);
-		}
-
-		// Go through all files and add them to the conflict map.
-		if (QDir(newFolder).exists())
-		{
-			QDirIterator it(newFolder, QStringList(), QDir::Files, QDirIterator::Subdirectories);
-			while (it.hasNext())
-			{
-				QString foundPath = it.next();
-				QString relativePath = foundPath.right(foundPath.length() - newFolder.length() - 1);
-				folderConflicts[relativePath].push_back(newFolder);
-			}
-		}
+		TRACE_SCOPE("TreeModModel::setData folder");
+		TreeModItem* item = getItem(index);
+		unregisterFolder(item, item->getFolder());
+		registerFolder(item, value.toString());
 	}
 
 	bool result = false;
@@ -266,7 +314,13 @@ bool TreeModModel::setData(const QModelIndex &index, const QVariant &value, int
 		result = getItem(index)->setData(index.column(), value);
 
 	if (result)
+	{
 		emit dataChanged(index, index);
+		if (index.column() == TreeModItem::COLUMN_FOLDER || index.column() == TreeModItem::COLUMN_ENABLED)
+			updateLoadOrder();
+		modsChanged = true;
+		emit modified();
+	}
 
 	return result;
 }
@@ -276,62 +330,317 @@ bool TreeModModel::setHeaderData(int section, Qt::Orientation orientation, const
 	if (role != Qt::EditRole || orientation != Qt::Horizontal)
 		return false;
 
-	bool result = rootItem->setData(section, value);
-	if (result)
-		emit headerDataChanged(orientation, section, section);
+	if (section < 0 || section >= headers.size())
+		return false;
 
-	return result;
+	headers[section] = value;
+	emit headerDataChanged(orientation, section, section);
+	return true;
 }
 
 void TreeModModel::addMods(const QJsonArray& modsArray, const QModelIndex& parent)
 {
-	foreach( QJsonValue mod, modsArray )
+	TRACE_SCOPE("TreeModModel::addMods");
+	TreeModItem mods;
+	mods.addChildrenFromJson(modsArray);
+	insertItems(rowCount(parent), &mods, parent);
+}
+
+//! One insertion for the whole subtree: a single layout change, one load order update and one batch of scans.
+bool TreeModModel::insertItems(int position, TreeModItem* items, const QModelIndex& parent)
+{
+	TRACE_SCOPE("TreeModModel::insertItems");
+	TreeModItem* parentItem = getItem(parent);
+	int count = items->childCount();
+	if (position < 0 || position > parentItem->childCount())
+		return false;
+	if (count == 0)
+		return true;
+
+	beginInsertRows(parent, position, position + count - 1);
+	parentItem->adoptChildren(position, items);
+	endInsertRows();
+
+	QStringList newFolders;
+	for (int row = position; row < position + count; row++)
+		registerItem(parentItem->child(row), newFolders);
+	scanner->enqueue(newFolders);
+
+	updateLoadOrder();
+	modsChanged = true;
+	emit modified();
+	return true;
+}
+
+void TreeModModel::loadData()
+{
+	// Coming from JSON, the tree is stored again on the way out so that mods.bin gets written.
+	if (loadDataFromBinary())
+	{
+		modsChanged = false;
+	}
+	else
+	{
+		loadDataFromJson();
+		modsChanged = true;
+	}
+}
+
+void TreeModModel::loadDataFromJson()
+{
+	TRACE_SCOPE("TreeModModel::loadDataFromJson");
+	addMods(settings->getModJson(), QModelIndex());
+}
+
+//! Streams mods.bin straight into the tree, without going through setData for every field.
+bool TreeModModel::loadDataFromBinary()
+{
+	TRACE_SCOPE("TreeModModel::loadDataFromBinary");
+	const QByteArray& modBinary = settings->getModBinary();
+	if (modBinary.isEmpty())
+		return false;
+
+	QDataStream stream(modBinary);
+	stream.setVersion(QDataStream::Qt_5_7);
+	if (!rootItem->readChildren(stream))
 	{
-		QJsonObject modTable = mod.toObject();
+		qWarning("Binary mod tree is corrupt; loading mods.json instead.");
+		rootItem->removeChildren(0, rootItem->childCount());
+		return false;
+	}
 
-		QVector<QVariant> data;
-		data << 0 << modTable["name"].toString() << modTable["folder"].toString() << modTable["enabled"].toBool();
+	QStringList newFolders;
+	for (int row = 0; row < rootItem->childCount(); row++)
+		registerItem(rootItem->child(row), newFolders);
+	scanner->enqueue(newFolders);
+	return true;
+}
 
-		int newRow = this->rowCount(parent);
-		this->insertRow(newRow, parent);
-		for (int column = 0; column < data.size(); column++)
-		{
-			this->setData(this->index(newRow, column, parent), data[column]);
-		}
+//! Returns whether any archive is now found somewhere else, or no longer found at all.
+bool TreeModModel::resolveArchives()
+{
+	QStringList names;
+	foreach (const QVariant& archive, config->getByKey("fallback-archive"))
+		names.push_back(archive.toString());
 
-		QJsonValue subModsV = modTable["mods"];
-		if (!subModsV.isUndefined())
+	QStringList dataFolders;
+	QStringList paths = locateDataFiles(names, &dataFolders);
+
+	QStringList resolved;
+	QHash<QString, QString> resolvedFolders;
+	for (int i = 0; i < names.size(); i++)
+	{
+		if (paths[i].isEmpty())
 		{
-			QJsonArray subModsArray = subModsV.toArray();
-			addMods(subModsArray, this->index(newRow, 0, parent));
+			// Until every folder is scanned, it may just not have been found yet.
+			if (scanner->isIdle())
+				qWarning() << "Warning: Could not locate archive '" + names[i] + "'";
+			continue;
 		}
+
+		resolved.push_back(paths[i]);
+		resolvedFolders.insert(paths[i], dataFolders[i]);
+	}
+
+	if (resolved == archives && resolvedFolders == archiveFolders)
+		return false;
+
+	foreach (const QString& archive, archives)
+	{
+		if (!resolvedFolders.contains(archive))
+			forgetFolder(archive);
+	}
+
+	// Archive contents are indexed like any other folder.
+	QStringList newArchives;
+	foreach (const QString& archive, resolved)
+	{
+		if (!archiveFolders.contains(archive))
+			newArchives.push_back(archive);
 	}
+
+	archives = resolved;
+	archiveFolders = resolvedFolders;
+	scanner->enqueue(newArchives);
+	return true;
 }
 
-void TreeModModel::loadDataFromJson()
+void TreeModModel::updateLoadOrder()
 {
-	QJsonArray modsArray = settings->getJsonDoc().object()["mods"].toArray();
-	addMods(modsArray, QModelIndex());
+	TRACE_SCOPE("TreeModModel::updateLoadOrder");
+
+	// Adding, removing or toggling folders can change where archives and content files come from.
+	QStringList dataFolders = getDataFolders();
+	bool foldersChanged = dataFolders != archiveSearchFolders;
+	if (foldersChanged)
+	{
+		archiveSearchFolders = dataFolders;
+		resolveArchives();
+	}
+
+	conflicts.setLoadOrder(archives + dataFolders);
+	emit conflictsChanged();
+	if (foldersChanged)
+		emit dataFilesChanged();
+
+	// Which rows override the selected one depends on the order too.
+	if (!currentSelection.isEmpty())
+		conflictRefreshTimer.start();
+}
+
+void TreeModModel::storeToInterfaces()
+{
+	saveDataToJson();
+	saveDataToConfig();
 }
 
 void TreeModModel::saveDataToJson()
 {
+	// Building the JSON for a big tree isn't cheap, and mods.json may not even have been parsed.
+	if (!modsChanged)
+		return;
+
+	TRACE_SCOPE("TreeModModel::saveDataToJson");
 	settings->setModJson(rootItem);
+	modsChanged = false;
 }
 
 void TreeModModel::saveDataToConfig()
 {
+	TRACE_SCOPE("TreeModModel::saveDataToConfig");
 	QVector<QVariant>& dataVect = config->getByKey("data");
 	dataVect.clear();
 	rootItem->serialize(dataVect);
 }
 
-void TreeModModel::recalculateIndexes(TreeModItem* parent, int startAt)
+void TreeModModel::registerFolder(TreeModItem* item, const QString& folder)
 {
-	for (int i = startAt; i < parent->childCount(); i++)
+	if (trackFolder(item, folder))
+		scanner->enqueue(folder);
+}
+
+//! Returns whether this is the first row to refer to the folder, in which case it needs scanning.
+bool TreeModModel::trackFolder(TreeModItem* item, const QString& folder)
+{
+	if (folder.isEmpty())
+		return false;
+
+	bool known = folderItems.contains(folder);
+	folderItems.insert(folder, item);
+	return !known;
+}
+
+void TreeModModel::unregisterFolder(TreeModItem* item, const QString& folder)
+{
+	if (folder.isEmpty())
+		return;
+
+	folderItems.remove(folder, item);
+	if (!folderItems.contains(folder))
+		forgetFolder(folder);
+}
+
+void TreeModModel::registerItem(TreeModItem* item, QStringList& newFolders)
+{
+	if (trackFolder(item, item->getFolder()))
+		newFolders.push_back(item->getFolder());
+	for (int child = 0; child < item->childCount(); child++)
+		registerItem(item->child(child), newFolders);
+}
+
+void TreeModModel::unregisterItem(TreeModItem* item)
+{
+	unregisterFolder(item, item->getFolder());
+	for (int child = 0; child < item->childCount(); child++)
+		unregisterItem(item->child(child));
+}
+
+void TreeModModel::forgetFolder(const QString& folder)
+{
+	if (folder.isEmpty())
+		return;
+
+	scanner->cancel(folder);
+	watcher->unwatchFolder(folder);
+	conflicts.removeFolder(folder);
+	emit pathsReleased();
+	emit conflictsChanged();
+}
+
+QStringList TreeModModel::locateDataFiles(const QStringList& fileNames, QStringList* dataFolders) const
+{
+	QStringList folders = getDataFolders();
+	QHash<QString, int> positions;
+	for (int i = 0; i < folders.size(); i++)
+		positions.insert(folders[i], i);
+
+	QStringList paths;
+	foreach (const QString& fileName, fileNames)
 	{
-		parent->child(i)->setData(TreeModItem::COLUMN_INDEX, i);
+		// Later data folders win, just like in OpenMW. Archives don't count; OpenMW doesn't load files out of them.
+		int position = -1;
+		const FolderIdList& providers = conflicts.getProviders(conflicts.getPathId(fileName));
+		for (int i = 0; i < providers.size(); i++)
+			position = qMax(position, positions.value(conflicts.getFolder(providers[i]), -1));
+
+		QString folder = position >= 0 ? folders[position] : QString();
+		paths.push_back(folder.isEmpty() ? QString() : folder + "/" + getDiskName(folder, fileName));
+		if (dataFolders)
+			dataFolders->push_back(folder);
 	}
+	return paths;
+}
+
+//! The index only keeps folded names; the scan cache still has them as they are on disk.
+QString TreeModModel::getDiskName(const QString& folder, const QString& fileName) const
+{
+	QString normalized = VfsPath::normalize(fileName);
+	int slash = normalized.lastIndexOf('/');
+	QString directory = slash < 0 ? QString() : normalized.left(slash);
+
+	ScanDirectoryMap directories = cache->lookup(folder);
+	for (ScanDirectoryMap::const_iterator it = directories.constBegin(); it != directories.constEnd(); ++it)
+	{
+		if (VfsPath::normalize(it.key()) != directory)
+			continue;
+
+		QString prefix = it.key().isEmpty() ? QString() : it.key() + "/";
+		foreach (const QString& file, it->files)
+		{
+			if (VfsPath::normalize(prefix + file) == normalized)
+				return prefix + file;
+		}
+	}
+	return fileName;
+}
+
+TreeModItem* TreeModModel::getItemForFolder(const QString& folder) const
+{
+	// Archives belong to the row of the data folder they were found in.
+	TreeModItem* item = folderItems.value(folder);
+	if (!item && archiveFolders.contains(folder))
+		item = folderItems.value(archiveFolders.value(folder));
+	return item;
+}
+
+bool TreeModModel::loadsBefore(const QString& folder, const QString& otherFolder) const
+{
+	// Archives are loaded before any loose files, in fallback-archive order.
+	int archive = archives.indexOf(folder);
+	int otherArchive = archives.indexOf(otherFolder);
+	if (archive >= 0 || otherArchive >= 0)
+	{
+		if (archive >= 0 && otherArchive >= 0)
+			return archive < otherArchive;
+		return archive >= 0;
+	}
+
+	TreeModItem* item = folderItems.value(folder);
+	TreeModItem* otherItem = folderItems.value(otherFolder);
+	if (!item || !otherItem)
+		return false;
+
+	return item->isBefore(otherItem);
 }
 
 QStringList TreeModModel::mimeTypes() const
@@ -343,7 +652,8 @@ QStringList TreeModModel::mimeTypes() const
 
 QMimeData* TreeModModel::mimeData(const QModelIndexList &indexes) const
 {
-	QMimeData *mimeData = new QMimeData();
+	TRACE_SCOPE("TreeModModel::mimeData");
+	QMimeData *mimeData = new TreeModMimeData(this, indexes);
 	QByteArray encodedData;
 
 	QDataStream stream(&encodedData, QIODevice::WriteOnly);
@@ -361,50 +671,72 @@ QMimeData* TreeModModel::mimeData(const QModelIndexList &indexes) const
 	return mimeData;
 }
 
-void TreeModModel::importFromDataStream(QDataStream& stream, const QModelIndex& parent, int row)
+//! Reads one item written by TreeModItem::serialize, with its children, into a subtree that isn't in the model yet.
+void TreeModModel::importFromDataStream(QDataStream& stream, TreeModItem* parent)
 {
-	if (!this->insertRow(row, parent))
-		return;
+	QVariant columnData[TreeModItem::COLUMN_COUNT];
+	for (int column = 0; column < TreeModItem::COLUMN_COUNT; column++)
+		stream >> columnData[column];
 
-	for (int column = 0; column < this->columnCount(); column++)
-	{
-		QVariant columnData;
-		stream >> columnData;
-		QModelIndex child = this->index(row, column, parent);
-		if (column == TreeModItem::COLUMN_INDEX)
-			this->setData(child, row);
-		else if (column == TreeModItem::COLUMN_ENABLED)
-			this->setData(child, columnData, Qt::CheckStateRole);
-		else
-			this->setData(child, columnData);
-	}
+	TreeModItem* item = parent->appendChild(columnData[TreeModItem::COLUMN_NAME].toString(),
+											columnData[TreeModItem::COLUMN_FOLDER].toString(),
+											columnData[TreeModItem::COLUMN_ENABLED].toBool());
 
 	// Handle children.
 	QVariant childrenCount;
 	stream >> childrenCount;
-	for (int child = 0; child < childrenCount.toInt(); child++)
-		importFromDataStream(stream, this->index(row, 0, parent), child);
+	for (int child = 0; child < childrenCount.toInt() && stream.status() == QDataStream::Ok; child++)
+		importFromDataStream(stream, item);
 }
 
 bool TreeModModel::dropMimeData(const QMimeData *data, Qt::DropAction action, int row, int column, const QModelIndex &parent)
 {
+	TRACE_SCOPE("TreeModModel::dropMimeData");
 	if (!canDropMimeData(data, action, row, column, parent))
 		return false;
 
 	if (action == Qt::IgnoreAction)
 		return true;
 
+	// Dropped onto an item rather than between two: it goes last.
+	if (row < 0)
+		row = rowCount(parent);
+
+	const TreeModMimeData* modData = qobject_cast<const TreeModMimeData*>(data);
+	if (modData && modData->getModel() == this && action == Qt::MoveAction)
+	{
+		// Each dragged row goes right after the one before it.
+		QPersistentModelIndex destinationParent(parent);
+		int destination = row;
+		bool moved = false;
+		foreach (const QPersistentModelIndex& index, modData->getIndexes())
+		{
+			if (!index.isValid())
+				continue;
+
+			if (moveRow(index.parent(), index.row(), destinationParent, destination))
+				moved = true;
+			if (index.parent() == destinationParent)
+				destination = index.row() + 1;
+		}
+
+		// ModTreeView keeps the drag from removing the moved rows afterwards.
+		return moved;
+	}
+
 	if (data->hasFormat("application/openmwmm.text.data"))
 	{
 		QByteArray encodedData = data->data("application/openmwmm.text.data");
 		QDataStream stream(&encodedData, QIODevice::ReadOnly);
+		stream.setVersion(QDataStream::Qt_5_7);
 
 		int sourceIndexCount;
 		stream >> sourceIndexCount;
-		for (int i = 0; i < sourceIndexCount; i++)
-			importFromDataStream(stream, parent, row+i);
+		TreeModItem items;
+		for (int i = 0; i < sourceIndexCount && stream.status() == QDataStream::Ok; i++)
+			importFromDataStream(stream, &items);
 
-		return true;
+		return insertItems(row, &items, parent);
 	}
 
 	return false;
@@ -433,20 +765,294 @@ Qt::DropActions TreeModModel::supportedDropActions() const
 	return Qt::MoveAction;
 }
 
-//! TODO: Optimize this.
+FolderScanner* TreeModModel::getScanner() const
+{
+	return scanner;
+}
+
+const ConflictIndex& TreeModModel::getConflicts() const
+{
+	return conflicts;
+}
+
+QStringList TreeModModel::getDataFolders() const
+{
+	QVector<QVariant> dataFolders;
+	rootItem->serialize(dataFolders);
+
+	QStringList folders;
+	foreach (const QVariant& folder, dataFolders)
+		folders.push_back(folder.toString());
+	return folders;
+}
+
+QStringList TreeModModel::getLoadOrder() const
+{
+	// Same order OpenMW's VFS uses: archives first, then the enabled data folders.
+	return archives + getDataFolders();
+}
+
+QStringList TreeModModel::getConflictFolders(const QString& folder) const
+{
+	// Archives found in a folder count as part of it.
+	QStringList folders;
+	if (!folder.isEmpty())
+		folders << folder << archiveFolders.keys(folder);
+	return folders;
+}
+
+// Orders folders the way the mod list does.
+struct ModOrderLess
+{
+	explicit ModOrderLess(const TreeModModel* modModel) : model(modModel) {}
+
+	bool operator()(const QString& folder, const QString& otherFolder) const
+	{
+		return model->loadsBefore(folder, otherFolder);
+	}
+
+	const TreeModModel* model;
+};
+
+QStringList TreeModModel::getProviderFolders(int pathId) const
+{
+	QStringList folders;
+	const FolderIdList& providers = conflicts.getProviders(pathId);
+	for (int i = 0; i < providers.size(); i++)
+		folders.push_back(conflicts.getFolder(providers[i]));
+
+	std::stable_sort(folders.begin(), folders.end(), ModOrderLess(this));
+	return folders;
+}
+
+QString TreeModModel::getDisplayName(const QString& folder) const
+{
+	if (archiveFolders.contains(folder))
+		return QFileInfo(folder).fileName();
+
+	TreeModItem* item = folderItems.value(folder);
+	if (!item)
+		return folder;
+	return item->getName();
+}
+
+void TreeModModel::setHashContents(bool enabled)
+{
+	if (hashContents == enabled)
+		return;
+
+	hashContents = enabled;
+	settings->setSetting("hashContents", enabled ? "true" : "false");
+	emit modified();
+
+	// Hashes that are already known stay; they just aren't used to hide anything any more.
+	if (enabled)
+		hashConflicts();
+	else
+		setHideIdentical(false);
+}
+
+bool TreeModModel::isHashingContents() const
+{
+	return hashContents;
+}
+
+void TreeModModel::setHideIdentical(bool enabled)
+{
+	if (conflicts.ignoresIdentical() == enabled)
+		return;
+
+	conflicts.setIgnoreIdentical(enabled);
+	settings->setSetting("hideIdentical", enabled ? "true" : "false");
+	emit conflictsChanged();
+	emit modified();
+
+	if (!currentSelection.isEmpty())
+		conflictRefreshTimer.start();
+}
+
+bool TreeModModel::isHidingIdentical() const
+{
+	return conflicts.ignoresIdentical();
+}
+
+ContentHasher* TreeModModel::getHasher() const
+{
+	return hasher;
+}
+
+void TreeModModel::hashConflicts()
+{
+	if (!hashContents)
+		return;
+
+	// While a batch is running, files that still need a hash are queued behind it; the hasher skips those it already has.
+	QVector<ContentHashJob> jobs;
+	foreach (const QString& folder, getLoadOrder())
+	{
+		int folderId = conflicts.getFolderId(folder);
+		if (folderId < 0)
+			continue;
+
+		QSet<QString> needed;
+		foreach (int pathId, conflicts.getFolderPaths(folderId))
+		{
+			if (conflicts.getProviders(pathId).size() >= 2 && conflicts.getContentHash(folderId, pathId) == 0)
+				needed.insert(conflicts.getPath(pathId));
+		}
+		if (needed.isEmpty())
+			continue;
+
+		ContentHashJob job;
+		job.folder = folder;
+		if (archives.contains(folder))
+		{
+			BsaArchive archive(folder);
+			if (!archive.open())
+				continue;
+
+			for (int file = 0; file < archive.fileCount(); file++)
+			{
+				job.relativePath = VfsPath::normalize(archive.fileName(file));
+				if (!needed.contains(job.relativePath))
+					continue;
+
+				job.filePath = folder;
+				job.offset = archive.fileOffset(file);
+				job.size = archive.fileSize(file);
+				jobs.push_back(job);
+			}
+			continue;
+		}
+
+		// The index only keeps folded names; the scan cache still has them as they are on disk.
+		ScanDirectoryMap directories = cache->lookup(folder);
+		for (ScanDirectoryMap::const_iterator it = directories.constBegin(); it != directories.constEnd(); ++it)
+		{
+			QString prefix = it.key().isEmpty() ? QString() : it.key() + "/";
+			foreach (const QString& file, it->files)
+			{
+				job.relativePath = prefix + file;
+				if (!needed.contains(VfsPath::normalize(job.relativePath)))
+					continue;
+
+				job.filePath = folder + "/" + job.relativePath;
+				jobs.push_back(job);
+			}
+		}
+	}
+
+	if (!jobs.isEmpty())
+		hasher->hash(jobs);
+}
+
+void TreeModModel::mergeHashes(const QVector<ContentHashJob>& jobs, const QVector<quint64>& hashes)
+{
+	TRACE_SCOPE("TreeModModel::mergeHashes");
+	for (int i = 0; i < jobs.size() && i < hashes.size(); i++)
+		conflicts.setContentHash(conflicts.getFolderId(jobs[i].folder), conflicts.getPathId(jobs[i].relativePath), hashes[i]);
+	emit conflictsChanged();
+
+	if (!currentSelection.isEmpty())
+		conflictRefreshTimer.start();
+}
+
+int TreeModModel::filesWon(const QModelIndex& index) const
+{
+	if (!index.isValid())
+		return 0;
+
+	int won = 0;
+	foreach (const QString& folder, getConflictFolders(getItem(index)->getFolder()))
+		won += conflicts.getFilesWon(conflicts.getFolderId(folder));
+	return won;
+}
+
+int TreeModModel::filesLost(const QModelIndex& index) const
+{
+	if (!index.isValid())
+		return 0;
+
+	int lost = 0;
+	foreach (const QString& folder, getConflictFolders(getItem(index)->getFolder()))
+		lost += conflicts.getFilesLost(conflicts.getFolderId(folder));
+	return lost;
+}
+
+void TreeModModel::mergeFolderScan(const QString& folder, const QStringList& relativePaths)
+{
+	TRACE_SCOPE("TreeModModel::mergeFolderScan");
+	// A rescan replaces everything the folder had before.
+	bool rescanned = conflicts.containsFolder(folder);
+	conflicts.addFolder(folder, relativePaths);
+	watcher->watchFolder(folder);
+	if (rescanned)
+		emit pathsReleased();
+	emit conflictsChanged();
+
+	if (hashContents)
+		hashTimer.start();
+
+	// Batch up highlighting updates while many folders finish at once.
+	if (!currentSelection.isEmpty())
+		conflictRefreshTimer.start();
+}
+
+void TreeModModel::mergeFolderChanges(const QString& folder, const QStringList& added, const QStringList& removed)
+{
+	conflicts.removePaths(folder, removed);
+	conflicts.addPaths(folder, added);
+	if (!removed.isEmpty())
+		emit pathsReleased();
+	emit conflictsChanged();
+
+	// Content files and archives sit at the top of a data folder.
+	foreach (const QString& relativePath, added + removed)
+	{
+		if (!relativePath.contains('/'))
+		{
+			refreshDataFiles();
+			break;
+		}
+	}
+
+	if (hashContents)
+		hashTimer.start();
+
+	if (!currentSelection.isEmpty())
+		conflictRefreshTimer.start();
+}
+
+void TreeModModel::refreshDataFiles()
+{
+	if (resolveArchives())
+	{
+		conflicts.setLoadOrder(getLoadOrder());
+		emit conflictsChanged();
+
+		if (!currentSelection.isEmpty())
+			conflictRefreshTimer.start();
+	}
+	emit dataFilesChanged();
+}
+
+void TreeModModel::refreshConflictSelection()
+{
+	QItemSelection selection = currentSelection;
+	currentSelection = QItemSelection();
+	updateConflictSelection(selection, QItemSelection());
+}
+
 void TreeModModel::updateConflictSelection(const QItemSelection& selected, const QItemSelection& deselected)
 {
+	TRACE_SCOPE("TreeModModel::updateConflictSelection");
 	Q_UNUSED(deselected);
 
 	if (selected == currentSelection)
 		return;
 	currentSelection = selected;
 
-	// Clear conflicts.
-	QModelIndexList selectionCopy = currentConflicts;
-	currentConflicts.clear();
-	foreach(const QModelIndex& index, selectionCopy)
-		this->dataChanged(index.sibling(index.row(), 0), index.sibling(index.row(), TreeModItem::COLUMN_COUNT), QVector<int>() << Qt::TextColorRole);
+	clearConflictHighlights();
 
 	// We don't care what happens if the selection is empty.
 	if (selected.empty())
@@ -470,33 +1076,64 @@ void TreeModModel::updateConflictSelection(const QItemSelection& selected, const
 		return;
 	}
 
-	QDirIterator it(baseFolder, QStringList(), QDir::Files, QDirIterator::Subdirectories);
-	while (it.hasNext())
+	// The selected mod gets scanned before anything else still waiting.
+	scanner->prioritize(baseFolder);
+
+	QStringList selectedFolders = getConflictFolders(baseFolder);
+
+	// Every folder sharing files with these is already known; nothing here touches the disk.
+	TreeModItem* selectedItem = getItem(thisIndex);
+	foreach (const QString& selectedFolder, selectedFolders)
 	{
-		QString foundPath = it.next();
-		QString relativePath = foundPath.right(foundPath.length() - baseFolder.length() - 1);
-		if (folderConflicts.contains(relativePath) && folderConflicts[relativePath].size() > 1)
+		int selectedFolderId = conflicts.getFolderId(selectedFolder);
+		const QHash<int, int>& overlaps = conflicts.getOverlaps(selectedFolderId);
+		for (QHash<int, int>::const_iterator it = overlaps.constBegin(); it != overlaps.constEnd(); ++it)
 		{
-			foreach (const QString& conflictingFolder, folderConflicts[relativePath])
-			{
-				if (conflictingFolder == baseFolder)
-					continue;
+			// Folders that only share identical copies don't really conflict.
+			if (conflicts.ignoresIdentical() && conflicts.getIdenticalOverlapCount(selectedFolderId, it.key()) >= it.value())
+				continue;
 
-				QModelIndex conflictingIndex = getIndexForFolder(conflictingFolder);
-				if (!conflictingIndex.isValid())
-				{
-					qDebug() << "Warning: Could not find index for conflict for '" + conflictingFolder + "'";
-					continue;
-				}
-
-				while (conflictingIndex.isValid())
-				{
-					currentConflicts.push_back(conflictingIndex.sibling(conflictingIndex.row(), 0));
-					this->dataChanged(conflictingIndex.sibling(conflictingIndex.row(), 0), conflictingIndex.sibling(conflictingIndex.row(), TreeModItem::COLUMN_COUNT), QVector<int>() << Qt::TextColorRole);
-					QModelIndex p = conflictingIndex.parent();
-					conflictingIndex = p.sibling(p.row(), conflictingIndex.column());
-				}
+			QString conflictingFolder = conflicts.getFolder(it.key());
+			TreeModItem* conflictingItem = getItemForFolder(conflictingFolder);
+			if (!conflictingItem)
+			{
+				qDebug() << "Warning: Could not find index for conflict for '" + conflictingFolder + "'";
+				continue;
 			}
+
+			if (conflictingItem == selectedItem)
+				continue;
+
+			// Whatever loads later wins.
+			TreeModItem::ConflictState state = loadsBefore(conflictingFolder, selectedFolder) ? TreeModItem::CONFLICT_OVERRIDDEN : TreeModItem::CONFLICT_OVERRIDES;
+			for (TreeModItem* item = conflictingItem; item && item != rootItem; item = item->parent())
+				highlightConflict(item, state);
 		}
 	}
 }
+
+void TreeModModel::clearConflictHighlights()
+{
+	QList<TreeModItem*> highlighted = conflictItems;
+	conflictItems.clear();
+	foreach (TreeModItem* item, highlighted)
+	{
+		item->setConflictState(TreeModItem::CONFLICT_NONE);
+		int row = item->childNumber();
+		emit dataChanged(createIndex(row, 0, item), createIndex(row, TreeModItem::COLUMN_COUNT - 1, item), QVector<int>() << Qt::TextColorRole);
+	}
+}
+
+void TreeModModel::highlightConflict(TreeModItem* item, TreeModItem::ConflictState state)
+{
+	TreeModItem::ConflictState previous = item->getConflictState();
+	if (previous == TreeModItem::CONFLICT_NONE)
+		conflictItems.push_back(item);
+	else if (previous >= state)
+		return;
+
+	// Overriding the selection is the more important thing to show.
+	item->setConflictState(state);
+	int row = item->childNumber();
+	emit dataChanged(createIndex(row, 0, item), createIndex(row, TreeModItem::COLUMN_COUNT - 1, item), QVector<int>() << Qt::TextColorRole);
+}
@@ -5,8 +5,14 @@
 #include <QAbstractItemModel>
 #include <QJsonDocument>
 #include <QItemSelection>
+#include <QTimer>
 
+#include "ConflictIndex.h"
+#include "ContentHasher.h"
+#include "FolderScanner.h"
+#include "FolderWatcher.h"
 #include "OpenMWConfigInterface.h"
+#include "ScanCache.h"
 #include "SettingsInterface.h"
 #include "TreeModItem.h"
 
@@ -38,7 +44,10 @@ public:
 	bool removeColumns(int position, int columns, const QModelIndex &parent = QModelIndex()) Q_DECL_OVERRIDE;
 	bool insertRows(int position, int rows, const QModelIndex &parent = QModelIndex()) Q_DECL_OVERRIDE;
 	bool removeRows(int position, int rows, const QModelIndex &parent = QModelIndex()) Q_DECL_OVERRIDE;
-	void importFromDataStream(QDataStream& stream, const QModelIndex& parent, int row);
+	bool moveRows(const QModelIndex &sourceParent, int sourceRow, int count, const QModelIndex &destinationParent, int destinationChild) Q_DECL_OVERRIDE;
+	// Inserts the children of items, built with TreeModItem::appendChild, as one transaction. Items is left empty.
+	bool insertItems(int position, TreeModItem* items, const QModelIndex& parent = QModelIndex());
+	void importFromDataStream(QDataStream& stream, TreeModItem* parent);
 
 	// Drag/drop
 	QStringList mimeTypes() const Q_DECL_OVERRIDE;
@@ -48,26 +57,100 @@ public:
 	Qt::DropActions supportedDragActions() const Q_DECL_OVERRIDE;
 	Qt::DropActions supportedDropActions() const Q_DECL_OVERRIDE;
 
+	FolderScanner* getScanner() const;
+	void storeToInterfaces();
+	const ConflictIndex& getConflicts() const;
+	QStringList getDataFolders() const;
+	QStringList getLoadOrder() const;
+	QStringList getConflictFolders(const QString& folder) const;
+	QString getDisplayName(const QString& folder) const;
+	// Every folder providing the path, loaded or not, in the order they appear: archives, then the tree.
+	QStringList getProviderFolders(int pathId) const;
+	bool loadsBefore(const QString& folder, const QString& otherFolder) const;
+	// Content hashing, so that byte-identical copies can be told apart from real conflicts.
+	void setHashContents(bool enabled);
+	bool isHashingContents() const;
+	void setHideIdentical(bool enabled);
+	bool isHidingIdentical() const;
+	ContentHasher* getHasher() const;
+
+	int filesWon(const QModelIndex& index) const;
+	int filesLost(const QModelIndex& index) const;
+	// Paths of content files or archives in the last enabled data folder that has them, or empty strings.
+	QStringList locateDataFiles(const QStringList& fileNames, QStringList* dataFolders = 0) const;
+
+signals:
+	// The conflict index or the load order changed.
+	void conflictsChanged();
+	// Path or folder IDs were freed and may be handed out again right away; anything holding on to IDs must drop them.
+	void pathsReleased();
+	// Something that is saved to mods.json or openmw.cfg changed.
+	void modified();
+	// Content files or archives may now be found somewhere else.
+	void dataFilesChanged();
+
 public slots:
 	void updateConflictSelection(const QItemSelection& selected, const QItemSelection& deselected);
+	void hashConflicts();
+
+private slots:
+	void mergeFolderScan(const QString& folder, const QStringList& relativePaths);
+	void mergeFolderChanges(const QString& folder, const QStringList& added, const QStringList& removed);
+	void refreshConflictSelection();
+	void mergeHashes(const QVector<ContentHashJob>& jobs, const QVector<quint64>& hashes);
+	void refreshDataFiles();
 
 private:
 	void addMods(const QJsonArray& modsArray, const QModelIndex& parent);
+	void loadData();
 	void loadDataFromJson();
+	bool loadDataFromBinary();
+	bool resolveArchives();
+	void updateLoadOrder();
 	void saveDataToJson();
 	void saveDataToConfig();
 
-	void recalculateIndexes(TreeModItem* parent, int startAt = 0);
+	void registerFolder(TreeModItem* item, const QString& folder);
+	void unregisterFolder(TreeModItem* item, const QString& folder);
+	bool trackFolder(TreeModItem* item, const QString& folder);
+	void registerItem(TreeModItem* item, QStringList& newFolders);
+	void unregisterItem(TreeModItem* item);
+	void forgetFolder(const QString& folder);
+
+	TreeModItem* getItemForFolder(const QString& folder) const;
+	QString getDiskName(const QString& folder, const QString& fileName) const;
+
+	void clearConflictHighlights();
+	void highlightConflict(TreeModItem* item, TreeModItem::ConflictState state);
 
 	TreeModItem *getItem(const QModelIndex &index) const;
 	TreeModItem *rootItem;
+	QVector<QVariant> headers;
 
 	SettingsInterface* settings;
 	OpenMWConfigInterface* config;
 
 	QItemSelection currentSelection;
-	QModelIndexList currentConflicts;
-	QMap<QString,QStringList> folderConflicts;
+	QList<TreeModItem*> conflictItems;
+	ConflictIndex conflicts;
+	QMultiHash<QString, TreeModItem*> folderItems;
+
+	// Archives from fallback-archive=, in load order, and the data folders they were found in.
+	QStringList archives;
+	QHash<QString, QString> archiveFolders;
+	// The data folders archives were last looked for in.
+	QStringList archiveSearchFolders;
+
+	FolderScanner* scanner;
+	ScanCache* cache;
+	FolderWatcher* watcher;
+	QTimer conflictRefreshTimer;
+
+	ContentHasher* hasher;
+	QTimer hashTimer;
+	bool hashContents;
+	// Whether the tree differs from what the settings interface last got.
+	bool modsChanged;
 };
 
 #endif // TREEMODMODEL_H
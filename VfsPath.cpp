@@ -0,0 +1,129 @@
+#include "VfsPath.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VFSPATH_SSE2
+#include <emmintrin.h>
+#endif
+
+static const quint64 PRIME64_1 = Q_UINT64_C(0x9E3779B185EBCA87);
+static const quint64 PRIME64_2 = Q_UINT64_C(0xC2B2AE3D27D4EB4F);
+static const quint64 PRIME64_3 = Q_UINT64_C(0x165667B19E3779F9);
+static const quint64 HASH_KEY[2] = { Q_UINT64_C(0xBE4BA423396CFEB8), Q_UINT64_C(0x1CAD21F72C81017C) };
+
+static inline ushort foldChar(ushort c)
+{
+	if (c >= 'A' && c <= 'Z')
+		return c | 0x20;
+	if (c == '\\')
+		return '/';
+	return c;
+}
+
+static inline quint64 rotateLeft(quint64 value, int bits)
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+VfsPath::VfsPath()
+{
+	pathHash = 0;
+}
+
+VfsPath::VfsPath(const QString& path)
+{
+	normalized = path;
+	pathHash = foldAndHash(reinterpret_cast<ushort*>(normalized.data()), normalized.size());
+}
+
+const QString& VfsPath::toString() const
+{
+	return normalized;
+}
+
+uint VfsPath::hash() const
+{
+	return pathHash;
+}
+
+bool VfsPath::operator==(const VfsPath& other) const
+{
+	return pathHash == other.pathHash && normalized == other.normalized;
+}
+
+bool VfsPath::operator!=(const VfsPath& other) const
+{
+	return !(*this == other);
+}
+
+QString VfsPath::normalize(const QString& path)
+{
+	return VfsPath(path).toString();
+}
+
+//! Folds the path in place, eight UTF-16 units at a time, and hashes the folded result.
+uint VfsPath::foldAndHash(ushort* data, int length)
+{
+	// Each 16-byte block is mixed into two 64-bit lanes: the lanes are swapped and added,
+	// and the low and high halves of each keyed lane are multiplied together.
+	quint64 accumulator[2] = { PRIME64_1, PRIME64_2 };
+	int i = 0;
+
+#ifdef VFSPATH_SSE2
+	const __m128i belowA = _mm_set1_epi16('A' - 1);
+	const __m128i aboveZ = _mm_set1_epi16('Z' + 1);
+	const __m128i caseBit = _mm_set1_epi16(0x20);
+	const __m128i backslash = _mm_set1_epi16('\\');
+	const __m128i slashFlip = _mm_set1_epi16('\\' ^ '/');
+	const __m128i key = _mm_set_epi64x(qint64(HASH_KEY[1]), qint64(HASH_KEY[0]));
+
+	__m128i lanes = _mm_set_epi64x(qint64(accumulator[1]), qint64(accumulator[0]));
+	for (; i + 8 <= length; i += 8)
+	{
+		__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+
+		// Anything at or above 0x8000 compares as negative, so only ASCII letters are touched.
+		__m128i upper = _mm_and_si128(_mm_cmpgt_epi16(block, belowA), _mm_cmplt_epi16(block, aboveZ));
+		__m128i slash = _mm_cmpeq_epi16(block, backslash);
+		block = _mm_xor_si128(block, _mm_or_si128(_mm_and_si128(upper, caseBit), _mm_and_si128(slash, slashFlip)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), block);
+
+		__m128i keyed = _mm_xor_si128(block, key);
+		__m128i product = _mm_mul_epu32(keyed, _mm_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1)));
+		lanes = _mm_add_epi64(lanes, _mm_shuffle_epi32(block, _MM_SHUFFLE(1, 0, 3, 2)));
+		lanes = _mm_add_epi64(lanes, product);
+	}
+
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(accumulator), lanes);
+#endif
+
+	for (; i + 8 <= length; i += 8)
+	{
+		for (int j = 0; j < 8; j++)
+			data[i + j] = foldChar(data[i + j]);
+
+		quint64 block[2];
+		memcpy(block, data + i, sizeof(block));
+		for (int lane = 0; lane < 2; lane++)
+		{
+			quint64 keyed = block[lane] ^ HASH_KEY[lane];
+			accumulator[lane] += block[lane ^ 1] + (keyed & 0xffffffff) * (keyed >> 32);
+		}
+	}
+
+	quint64 tail = PRIME64_3 ^ quint64(length);
+	for (; i < length; i++)
+	{
+		data[i] = foldChar(data[i]);
+		tail = (tail ^ data[i]) * PRIME64_1;
+	}
+
+	quint64 result = accumulator[0] ^ rotateLeft(accumulator[1], 31) ^ tail;
+	result ^= result >> 33;
+	result *= PRIME64_2;
+	result ^= result >> 29;
+	result *= PRIME64_3;
+	result ^= result >> 32;
+	return uint(result);
+}
@@ -0,0 +1,35 @@
+#ifndef VFSPATH_H
+#define VFSPATH_H
+
+#include <QString>
+
+/**
+ * A relative path folded the same way OpenMW's VFS does: ASCII lowercase, with '\' turned into '/'.
+ * The hash is computed in the same pass as the folding, so it never has to be computed again.
+ */
+class VfsPath
+{
+public:
+	VfsPath();
+	explicit VfsPath(const QString& path);
+
+	const QString& toString() const;
+	uint hash() const;
+
+	bool operator==(const VfsPath& other) const;
+	bool operator!=(const VfsPath& other) const;
+
+	static QString normalize(const QString& path);
+	static uint foldAndHash(ushort* data, int length);
+
+private:
+	QString normalized;
+	uint pathHash;
+};
+
+inline uint qHash(const VfsPath& path, uint seed = 0)
+{
+	return path.hash() ^ seed;
+}
+
+#endif // VFSPATH_H
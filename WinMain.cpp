@@ -4,8 +4,12 @@
 #include <QStandardItem>
 #include <QStandardItemModel>
 #include <QCheckBox>
+#include <QDockWidget>
 #include <QFileDialog>
 #include <QMessageBox>
+#include <QSortFilterProxyModel>
+#include <QTableView>
+#include <QTreeView>
 
 WinMain::WinMain(QWidget *parent) :
 	QMainWindow(parent),
@@ -14,15 +18,7 @@ WinMain::WinMain(QWidget *parent) :
 	ui->setupUi(this);
 	
 	// Get OpenMW config folder.
-	QString configFolder;
-	#if defined(Q_OS_MACOS)
-		configFolder = QStandardPaths::locate(QStandardPaths::ConfigLocation, "openmw", QStandardPaths::LocateDirectory);
-	#elif defined(Q_OS_WIN)
-		configFolder = QStandardPaths::locate(QStandardPaths::DocumentsLocation, "My Games/OpenMW", QStandardPaths::LocateDirectory);
-	#elif defined(Q_OS_LINUX)
-		// Default flatpak location
-		configFolder = QStandardPaths::locate(QStandardPaths::HomeLocation, ".var/app/org.openmw.OpenMW/config/openmw/", QStandardPaths::LocateDirectory);
-	#endif
+	QString configFolder = OpenMWConfigInterface::defaultConfigFolder();
 
 	// If not found automatically, ask where it is...
 	if(configFolder.isEmpty())
@@ -50,6 +46,78 @@ WinMain::WinMain(QWidget *parent) :
 	connect(ui->tvMain->selectionModel(), SIGNAL(selectionChanged(QItemSelection, QItemSelection)),
 			model, SLOT(updateConflictSelection(const QItemSelection&, const QItemSelection&)));
 
+	// Edits are saved in the background as they happen, so a crash doesn't lose the session.
+	saveScheduler = new SaveScheduler(model, settings, openMWConfig, this);
+
+	// Show background folder scanning in the status bar.
+	scanProgress = new QProgressBar(this);
+	scanProgress->setMaximumWidth(200);
+	scanProgress->setFormat(tr("Scanning %v/%m"));
+	scanProgress->hide();
+	ui->statusBar->addPermanentWidget(scanProgress);
+	connect(model->getScanner(), SIGNAL(progressChanged(int,int)),
+			this, SLOT(actScanProgress(int,int)));
+
+	// Record conflicts between content files, filtered by the selected mod.
+	recordConflicts = new RecordConflictModel(this);
+	QTableView* recordView = new QTableView(this);
+	recordView->setModel(recordConflicts);
+	recordView->setSelectionBehavior(QAbstractItemView::SelectRows);
+	recordView->verticalHeader()->hide();
+	recordView->horizontalHeader()->setStretchLastSection(true);
+	QDockWidget* recordDock = new QDockWidget(tr("Record Conflicts"), this);
+	recordDock->setObjectName("dockRecordConflicts");
+	recordDock->setWidget(recordView);
+	addDockWidget(Qt::BottomDockWidgetArea, recordDock);
+	connect(ui->tvMain->selectionModel(), SIGNAL(selectionChanged(QItemSelection, QItemSelection)),
+			this, SLOT(actSelectionChanged(const QItemSelection&, const QItemSelection&)));
+	loadRecordConflicts();
+	connect(model, SIGNAL(dataFilesChanged()),
+			this, SLOT(actDataFilesChanged()));
+
+	// Every conflicting file, with its providers and the winner, also filtered by the selected mod.
+	fileConflicts = new ConflictReportModel(model, this);
+	QTreeView* fileView = new QTreeView(this);
+	fileView->setModel(fileConflicts);
+	fileView->setRootIsDecorated(false);
+	fileView->setUniformRowHeights(true);
+	fileView->setSelectionBehavior(QAbstractItemView::SelectRows);
+	QDockWidget* fileDock = new QDockWidget(tr("File Conflicts"), this);
+	fileDock->setObjectName("dockFileConflicts");
+	fileDock->setWidget(fileView);
+	tabifyDockWidget(recordDock, fileDock);
+
+	// Which pairs of mods overlap the most, across the whole list.
+	overlaps = new ConflictMatrixModel(model, this);
+	QSortFilterProxyModel* overlapSorter = new QSortFilterProxyModel(this);
+	overlapSorter->setSourceModel(overlaps);
+	overlapSorter->setSortRole(ConflictMatrixModel::SortRole);
+	QTableView* overlapView = new QTableView(this);
+	overlapView->setModel(overlapSorter);
+	overlapView->setSortingEnabled(true);
+	overlapView->sortByColumn(ConflictMatrixModel::COLUMN_SHARED, Qt::DescendingOrder);
+	overlapView->setSelectionBehavior(QAbstractItemView::SelectRows);
+	overlapView->verticalHeader()->hide();
+	overlapView->horizontalHeader()->setStretchLastSection(true);
+	QDockWidget* overlapDock = new QDockWidget(tr("Mod Overlaps"), this);
+	overlapDock->setObjectName("dockModOverlaps");
+	overlapDock->setWidget(overlapView);
+	tabifyDockWidget(fileDock, overlapDock);
+
+	// Which mods provide a given file, found by name or glob.
+	FileSearchWidget* fileSearch = new FileSearchWidget(model, this);
+	QDockWidget* searchDock = new QDockWidget(tr("File Search"), this);
+	searchDock->setObjectName("dockFileSearch");
+	searchDock->setWidget(fileSearch);
+	tabifyDockWidget(overlapDock, searchDock);
+	connect(fileSearch, SIGNAL(folderActivated(QString)),
+			this, SLOT(actShowFolder(QString)));
+
+	// Content hashing is optional, since it has to read every conflicting file once.
+	ui->actionHashContents->setChecked(model->isHashingContents());
+	ui->actionHideIdentical->setChecked(model->isHidingIdentical());
+	ui->actionHideIdentical->setEnabled(model->isHashingContents());
+
 	// Resize columns to fit.
 	for (int column = 0; column < ui->tvMain->header()->count(); column++)
 		ui->tvMain->resizeColumnToContents(column);
@@ -63,6 +131,9 @@ WinMain::WinMain(QWidget *parent) :
 
 WinMain::~WinMain()
 {
+	saveScheduler->flush();
+	delete saveScheduler;
+
 	QAbstractItemModel* model = ui->tvMain->model();
 	delete ui;
 	delete model;
@@ -77,7 +148,7 @@ void WinMain::actAddData()
 		return;
 
 	QModelIndex index = ui->tvMain->selectionModel()->currentIndex();
-	addNewData(ui->tvMain->model(), index.parent(), index.row()+1, result);
+	addNewData(index.parent(), index.row()+1, QList<QFileInfo>() << result);
 }
 
 void WinMain::actAddChildData()
@@ -87,7 +158,7 @@ void WinMain::actAddChildData()
 		return;
 
 	QModelIndex index = ui->tvMain->selectionModel()->currentIndex();
-	addNewData(ui->tvMain->model(), index, 0, result);
+	addNewData(index, 0, QList<QFileInfo>() << result);
 }
 
 void WinMain::actDeleteData()
@@ -153,6 +224,77 @@ void WinMain::actContextMenuDataTreeHeaderTriggered(QAction* action)
 	ui->tvMain->header()->setSectionHidden(column, !ui->tvMain->header()->isSectionHidden(column));
 }
 
+void WinMain::actScanProgress(int done, int total)
+{
+	if (total == 0)
+	{
+		scanProgress->hide();
+		return;
+	}
+
+	scanProgress->setRange(0, total);
+	scanProgress->setValue(done);
+	scanProgress->show();
+}
+
+void WinMain::actHashContents(bool enabled)
+{
+	TreeModModel* model = static_cast<TreeModModel*>(ui->tvMain->model());
+	model->setHashContents(enabled);
+	ui->actionHideIdentical->setEnabled(enabled);
+}
+
+void WinMain::actHideIdentical(bool enabled)
+{
+	TreeModModel* model = static_cast<TreeModModel*>(ui->tvMain->model());
+	model->setHideIdentical(enabled);
+}
+
+void WinMain::actExportOverlaps()
+{
+	QString path = QFileDialog::getSaveFileName(this, tr("Export Mod Overlaps"), QString(), tr("Comma-separated values (*.csv)"));
+	if (path.isEmpty())
+		return;
+
+	// The list may still be waiting for scans to settle.
+	overlaps->refresh();
+
+	QFile file(path);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Text) || !overlaps->writeCsv(&file))
+		QMessageBox::warning(this, tr("Export Mod Overlaps"), tr("Couldn't write %1.").arg(path));
+}
+
+void WinMain::actShowFolder(const QString& folder)
+{
+	TreeModModel* model = static_cast<TreeModModel*>(ui->tvMain->model());
+	QModelIndex index = model->getIndexForFolder(folder);
+	if (!index.isValid())
+		return;
+
+	ui->tvMain->setCurrentIndex(index);
+	ui->tvMain->scrollTo(index);
+}
+
+void WinMain::actDataFilesChanged()
+{
+	loadRecordConflicts();
+}
+
+void WinMain::actSelectionChanged(const QItemSelection& selected, const QItemSelection& deselected)
+{
+	Q_UNUSED(deselected);
+
+	QString folder;
+	if (!selected.isEmpty())
+	{
+		QModelIndex index = selected.indexes().first();
+		folder = index.sibling(index.row(), TreeModItem::COLUMN_FOLDER).data().toString();
+	}
+
+	recordConflicts->setFilterFolder(folder);
+	fileConflicts->setFilterFolder(folder);
+}
+
 void WinMain::dragEnterEvent(QDragEnterEvent* event)
 {
 	auto data = event->mimeData()->data("text/uri-list");
@@ -182,17 +324,21 @@ void WinMain::dropEvent(QDropEvent* event)
 	auto data = event->mimeData()->data("text/uri-list");
 	QTextStream stream(&data);
 	QString uri = stream.readLine();
+	QList<QFileInfo> folders;
 	while (!uri.isEmpty())
 	{
 		QFileInfo file = QUrl(uri).toLocalFile();
 		if (file.isDir() && file.exists())
-		{
-			addNewData(ui->tvMain->model(), ui->tvMain->rootIndex(), ui->tvMain->model()->rowCount(), file);
-			event->acceptProposedAction();
-		}
+			folders.push_back(file);
 
 		uri = stream.readLine();
 	}
+
+	if (!folders.isEmpty())
+	{
+		addNewData(ui->tvMain->rootIndex(), ui->tvMain->model()->rowCount(), folders);
+		event->acceptProposedAction();
+	}
 }
 
 QString WinMain::locateConfigFolder()
@@ -232,58 +378,72 @@ QString WinMain::locateConfigFolder()
 }
 
 
-void WinMain::addNewData(QAbstractItemModel* model, const QModelIndex& parent, int position, const QFileInfo& target)
+void WinMain::loadRecordConflicts()
 {
-	// Get path as string.
-	QString path = target.absoluteFilePath();
+	TreeModModel* model = static_cast<TreeModModel*>(ui->tvMain->model());
 
-	//! Make sure we aren't adding a duplicate.
+	QStringList contents;
+	foreach (const QVariant& content, openMWConfig->getByKey("content"))
+		contents.push_back(content.toString());
 
-	// Add to model.
-	if (!model->insertRow(position, parent))
-		return;
-	for (int column = 0; column < model->columnCount(parent); ++column) {
-		QModelIndex child = model->index(position, column, parent);
-		if ( column == TreeModItem::COLUMN_INDEX )
-			model->setData(child, position, Qt::EditRole);
-		else if ( column == TreeModItem::COLUMN_NAME )
-			model->setData(child, target.baseName(), Qt::EditRole);
-		else if ( column == TreeModItem::COLUMN_FOLDER )
-			model->setData(child, target.absoluteFilePath(), Qt::EditRole);
-		else if ( column == TreeModItem::COLUMN_ENABLED )
-			model->setData(child, true, Qt::EditRole);
-		else
-			model->setData(child, QVariant("[No data]"), Qt::EditRole);
+	QStringList contentFolders;
+	QStringList contentPaths = model->locateDataFiles(contents, &contentFolders);
+
+	QStringList plugins;
+	QStringList pluginPaths;
+	QStringList pluginFolders;
+	for (int i = 0; i < contents.size(); i++)
+	{
+		if (contentPaths[i].isEmpty())
+		{
+			// Until every folder is scanned, it may just not have been found yet.
+			if (model->getScanner()->isIdle())
+				qDebug() << "Warning: Could not locate content file '" << contents[i] << "'";
+			continue;
+		}
+
+		plugins.push_back(contents[i]);
+		pluginPaths.push_back(contentPaths[i]);
+		pluginFolders.push_back(contentFolders[i]);
 	}
 
-	// Look for valid sub-elements.
-	QDirIterator it(target.absoluteFilePath(), QDir::AllDirs);
-	while (it.hasNext())
+	// Parsing every plugin again is only worth it if one of them is now somewhere else.
+	if (pluginPaths == recordPluginPaths)
+		return;
+
+	recordPluginPaths = pluginPaths;
+	recordConflicts->load(plugins, pluginPaths, pluginFolders);
+}
+
+void WinMain::addNewData(const QModelIndex& parent, int position, const QList<QFileInfo>& targets)
+{
+	TreeModModel* model = static_cast<TreeModModel*>(ui->tvMain->model());
+
+	//! Make sure we aren't adding a duplicate.
+
+	// Build every new row first, so the model takes them in a single insertion.
+	TreeModItem items;
+	foreach (const QFileInfo& target, targets)
 	{
-		QFileInfo subFolder = it.next();
-		bool converted = false;
-		QVariant firstToken = subFolder.baseName().split(" ").at(0);
-		int firstTokenAsInt = firstToken.toString().toInt(&converted);
-		if (converted)
+		TreeModItem* item = items.appendChild(target.baseName(), target.absoluteFilePath(), true);
+
+		// Look for valid sub-elements.
+		QDirIterator it(target.absoluteFilePath(), QDir::AllDirs);
+		while (it.hasNext())
 		{
-			QModelIndex newParent = model->index(position, 0, parent);
-			if (!model->insertRow(model->rowCount(newParent), newParent))
-				return;
-			for (int column = 0; column < model->columnCount(parent); ++column) {
-				QModelIndex child = model->index(model->rowCount(newParent)-1, column, newParent);
-				if ( column == TreeModItem::COLUMN_INDEX )
-					model->setData(child, firstTokenAsInt, Qt::EditRole);
-				else if ( column == TreeModItem::COLUMN_NAME )
-					model->setData(child, subFolder.baseName().right(subFolder.baseName().length() - firstToken.toString().length() - 1), Qt::EditRole);
-				else if ( column == TreeModItem::COLUMN_FOLDER )
-					model->setData(child, subFolder.absoluteFilePath(), Qt::EditRole);
-				else if ( column == TreeModItem::COLUMN_ENABLED )
-					model->setData(child, true, Qt::EditRole);
-				else
-					model->setData(child, QVariant("[No data]"), Qt::EditRole);
-			}
+			QFileInfo subFolder = it.next();
+			bool converted = false;
+			QString firstToken = subFolder.baseName().split(" ").at(0);
+			firstToken.toInt(&converted);
+			if (converted)
+				item->appendChild(subFolder.baseName().right(subFolder.baseName().length() - firstToken.length() - 1), subFolder.absoluteFilePath(), true);
 		}
 	}
 
-	ui->tvMain->expand(ui->tvMain->model()->index(position, 0, parent));
+	int count = items.childCount();
+	if (!model->insertItems(position, &items, parent))
+		return;
+
+	for (int row = position; row < position + count; row++)
+		ui->tvMain->expand(model->index(row, 0, parent));
 }
@@ -8,11 +8,17 @@
 #include <QDirIterator>
 #include <QFileInfo>
 #include <QMimeData>
+#include <QProgressBar>
 #include <QStandardPaths>
 #include <QTextCodec>
 #include <QTextStream>
 
+#include "ConflictMatrixModel.h"
+#include "ConflictReportModel.h"
+#include "FileSearchWidget.h"
 #include "OpenMWConfigInterface.h"
+#include "RecordConflictModel.h"
+#include "SaveScheduler.h"
 #include "SettingsInterface.h"
 #include "TreeModModel.h"
 #include "TreeModItem.h"
@@ -39,6 +45,14 @@ public slots:
 
 	void actContextMenuDataTreeHeaderTriggered(QAction* action);
 
+	void actScanProgress(int done, int total);
+	void actHashContents(bool enabled);
+	void actHideIdentical(bool enabled);
+	void actExportOverlaps();
+	void actShowFolder(const QString& folder);
+	void actDataFilesChanged();
+	void actSelectionChanged(const QItemSelection& selected, const QItemSelection& deselected);
+
 protected:
 	void dragEnterEvent(QDragEnterEvent* event) Q_DECL_OVERRIDE;
 	void dragMoveEvent(QDragMoveEvent* event) Q_DECL_OVERRIDE;
@@ -47,12 +61,21 @@ protected:
 private:
 	/** Open a file-chooser to locate config folder manually. */
 	QString locateConfigFolder();
-	void addNewData(QAbstractItemModel* model, const QModelIndex& parent, int position, const QFileInfo& target);
+	void addNewData(const QModelIndex& parent, int position, const QList<QFileInfo>& targets);
+	void loadRecordConflicts();
 
 	Ui::WinMain *ui;
 
 	SettingsInterface* settings;
 	OpenMWConfigInterface* openMWConfig;
+
+	QProgressBar* scanProgress;
+	RecordConflictModel* recordConflicts;
+	ConflictReportModel* fileConflicts;
+	ConflictMatrixModel* overlaps;
+	// Where the plugins behind recordConflicts were found.
+	QStringList recordPluginPaths;
+	SaveScheduler* saveScheduler;
 };
 
 #endif // WINMAIN_H
@@ -0,0 +1,16 @@
+#-------------------------------------------------
+#
+# Microbenchmarks for scanning, conflict indexing, selection and config I/O.
+#
+#-------------------------------------------------
+
+QT       += core gui concurrent widgets
+
+TARGET = OpenMW-MM-bench
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../OpenMW-MM.pri)
+
+SOURCES += main.cpp
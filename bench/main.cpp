@@ -0,0 +1,436 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+#include <algorithm>
+#include <functional>
+#include <random>
+
+#include "BsaArchive.h"
+#include "ConflictIndex.h"
+#include "FolderScanner.h"
+#include "OpenMWConfigInterface.h"
+#include "ScanCache.h"
+#include "SettingsInterface.h"
+#include "TreeModModel.h"
+
+struct TreeShape
+{
+	int mods;
+	int filesPerMod;
+	double overlap;
+	int directories;
+	unsigned int seed;
+};
+
+/** Collects timings per benchmark and turns them into one JSON object each. */
+class Results
+{
+public:
+	void measure(const QString& name, int iterations, const std::function<void()>& body)
+	{
+		QVector<double> samples;
+		for (int i = 0; i < iterations; i++)
+		{
+			QElapsedTimer timer;
+			timer.start();
+			body();
+			samples.push_back(timer.nsecsElapsed() / 1000000.0);
+		}
+		add(name, samples);
+	}
+
+	void add(const QString& name, QVector<double> samples)
+	{
+		if (samples.isEmpty())
+			return;
+
+		std::sort(samples.begin(), samples.end());
+		double total = 0;
+		foreach (double sample, samples)
+			total += sample;
+
+		QJsonObject result;
+		result["name"] = name;
+		result["iterations"] = samples.size();
+		result["min_ms"] = samples.first();
+		result["median_ms"] = samples[samples.size() / 2];
+		result["mean_ms"] = total / samples.size();
+		result["max_ms"] = samples.last();
+		results.push_back(result);
+
+		QTextStream(stderr) << name << ": " << samples[samples.size() / 2] << " ms\n";
+	}
+
+	QJsonArray toJson() const
+	{
+		return results;
+	}
+
+private:
+	QJsonArray results;
+};
+
+static void touch(const QString& path)
+{
+	QFile file(path);
+	file.open(QIODevice::WriteOnly);
+}
+
+//! Lays out mods as dataN/<dir>/<file>. A share of every mod's files comes from a pool all mods draw from.
+static QStringList generateTree(const QString& root, const TreeShape& shape)
+{
+	std::mt19937 random(shape.seed);
+	std::uniform_real_distribution<double> chance(0.0, 1.0);
+	std::uniform_int_distribution<int> directory(0, shape.directories - 1);
+
+	int sharedPoolSize = std::max(1, shape.filesPerMod * 4);
+	std::uniform_int_distribution<int> sharedFile(0, sharedPoolSize - 1);
+
+	QStringList folders;
+	for (int mod = 0; mod < shape.mods; mod++)
+	{
+		QString folder = QString("%1/mod%2").arg(root).arg(mod, 5, 10, QChar('0'));
+		QDir().mkpath(folder);
+		for (int dir = 0; dir < shape.directories; dir++)
+			QDir().mkpath(QString("%1/textures/d%2").arg(folder).arg(dir));
+
+		for (int file = 0; file < shape.filesPerMod; file++)
+		{
+			if (chance(random) < shape.overlap)
+			{
+				int shared = sharedFile(random);
+				touch(QString("%1/textures/d%2/shared%3.dds").arg(folder).arg(shared % shape.directories).arg(shared));
+			}
+			else
+			{
+				touch(QString("%1/textures/d%2/mod%3_%4.dds").arg(folder).arg(directory(random)).arg(mod).arg(file));
+			}
+		}
+
+		folders.push_back(folder);
+	}
+	return folders;
+}
+
+static void waitForScanner(FolderScanner* scanner)
+{
+	// The model queues archives once the data folders are done.
+	while (!scanner->isIdle())
+	{
+		QEventLoop loop;
+		QObject::connect(scanner, SIGNAL(finished()), &loop, SLOT(quit()));
+		loop.exec();
+	}
+}
+
+static QHash<QString, QStringList> scanFolders(const QStringList& folders, ScanCache* cache)
+{
+	QHash<QString, QStringList> scanned;
+	FolderScanner scanner;
+	scanner.setCache(cache);
+	QObject::connect(&scanner, &FolderScanner::folderScanned, [&scanned](const QString& folder, const QStringList& relativePaths) {
+		scanned.insert(folder, relativePaths);
+	});
+
+	foreach (const QString& folder, folders)
+		scanner.enqueue(folder);
+	waitForScanner(&scanner);
+	return scanned;
+}
+
+//! Packs a BSA into each of the first mods: every other file is also loose next to it, the rest only exist inside.
+static QStringList generateArchives(const QStringList& folders, const QHash<QString, QStringList>& scanned, int count)
+{
+	QStringList archiveNames;
+	for (int i = 0; i < count && i < folders.size(); i++)
+	{
+		QStringList looseFiles = scanned.value(folders[i]);
+		QMap<QString, QByteArray> files;
+		for (int file = 0; file < looseFiles.size(); file++)
+		{
+			QString path = file % 2 == 0 ? looseFiles[file] : QString("meshes/bench%1/m%2.nif").arg(i).arg(file);
+			files.insert(path, path.toLatin1());
+		}
+
+		QString name = QString("bench%1.bsa").arg(i);
+		if (!BsaArchive::create(folders[i] + "/" + name, files))
+			return QStringList();
+		archiveNames.push_back(name);
+	}
+	return archiveNames;
+}
+
+//! Archives must be found in their mod, list everything that was packed, and lose every file that is also loose.
+static bool checkArchives(const TreeModModel& model, const QStringList& folders, const QHash<QString, QStringList>& scanned, const QStringList& archiveNames)
+{
+	const ConflictIndex& conflicts = model.getConflicts();
+	for (int i = 0; i < archiveNames.size(); i++)
+	{
+		int archiveId = conflicts.getFolderId(folders[i] + "/" + archiveNames[i]);
+		QStringList looseFiles = scanned.value(folders[i]);
+		if (archiveId < 0 || conflicts.getFolderPaths(archiveId).size() != looseFiles.size())
+			return false;
+
+		for (int file = 0; file < looseFiles.size(); file++)
+		{
+			QString path = file % 2 == 0 ? looseFiles[file] : QString("meshes/bench%1/m%2.nif").arg(i).arg(file);
+			int pathId = conflicts.getPathId(path);
+			const FolderIdList& providers = conflicts.getProviders(pathId);
+			if (std::find(providers.constBegin(), providers.constEnd(), archiveId) == providers.constEnd())
+				return false;
+			if ((conflicts.getWinner(pathId) == archiveId) != (file % 2 != 0))
+				return false;
+		}
+	}
+	return true;
+}
+
+static void writeConfigFolder(const QString& configFolder, const QStringList& folders, const QStringList& archiveNames)
+{
+	QJsonArray mods;
+	foreach (const QString& folder, folders)
+	{
+		QJsonObject mod;
+		mod["name"] = QFileInfo(folder).fileName();
+		mod["folder"] = folder;
+		mod["enabled"] = true;
+		mods.push_back(mod);
+	}
+
+	QJsonObject root;
+	root["mods"] = mods;
+	root["settings"] = QJsonObject();
+
+	QFile json(configFolder + "/mods.json");
+	json.open(QIODevice::WriteOnly);
+	json.write(QJsonDocument(root).toJson());
+
+	QFile cfg(configFolder + "/openmw.cfg");
+	cfg.open(QIODevice::WriteOnly | QIODevice::Text);
+	foreach (const QString& folder, folders)
+		cfg.write(QString("data=" + folder + "\n").toUtf8());
+	foreach (const QString& archive, archiveNames)
+		cfg.write(QString("fallback-archive=" + archive + "\n").toUtf8());
+	cfg.write("content=Morrowind.esm\n");
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication a(argc, argv);
+	QCoreApplication::setApplicationName("OpenMW-MM-bench");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Times scanning, conflict indexing, selection and config I/O on a generated mod tree.");
+	parser.addHelpOption();
+	QCommandLineOption modsOption("mods", "Number of mods to generate.", "count", "200");
+	QCommandLineOption filesOption("files", "Total number of files across all mods.", "count", "20000");
+	QCommandLineOption overlapOption("overlap", "Share of each mod's files drawn from a common pool, 0 to 1.", "fraction", "0.1");
+	QCommandLineOption directoriesOption("directories", "Directories per mod.", "count", "16");
+	QCommandLineOption archivesOption("archives", "Number of mods that also get a BSA.", "count", "4");
+	QCommandLineOption iterationsOption("iterations", "Repetitions of each timed operation.", "count", "5");
+	QCommandLineOption seedOption("seed", "Random seed for the generated tree.", "seed", "1");
+	QCommandLineOption outputOption(QStringList() << "o" << "output", "Write JSON results to <file> instead of standard output.", "file");
+	parser.addOption(modsOption);
+	parser.addOption(filesOption);
+	parser.addOption(overlapOption);
+	parser.addOption(directoriesOption);
+	parser.addOption(archivesOption);
+	parser.addOption(iterationsOption);
+	parser.addOption(seedOption);
+	parser.addOption(outputOption);
+	parser.process(a);
+
+	TreeShape shape;
+	shape.mods = std::max(1, parser.value(modsOption).toInt());
+	shape.filesPerMod = std::max(1, parser.value(filesOption).toInt() / shape.mods);
+	shape.overlap = qBound(0.0, parser.value(overlapOption).toDouble(), 1.0);
+	shape.directories = std::max(1, parser.value(directoriesOption).toInt());
+	shape.seed = parser.value(seedOption).toUInt();
+	int archiveCount = std::max(0, parser.value(archivesOption).toInt());
+	int iterations = std::max(1, parser.value(iterationsOption).toInt());
+
+	QTemporaryDir workDir;
+	if (!workDir.isValid())
+	{
+		qCritical("Couldn't create a temporary directory.");
+		return 1;
+	}
+
+	QString dataRoot = workDir.path() + "/data";
+	QString configFolder = workDir.path() + "/config";
+	QDir().mkpath(configFolder);
+
+	Results results;
+	QElapsedTimer generateTimer;
+	generateTimer.start();
+	QStringList folders = generateTree(dataRoot, shape);
+	QTextStream(stderr) << "Generated " << shape.mods * shape.filesPerMod << " files in " << generateTimer.elapsed() << " ms\n";
+
+	// Scanning, without a cache and then with one that is already warm.
+	QHash<QString, QStringList> scanned;
+	results.measure("scan.cold", iterations, [&]() {
+		scanned = scanFolders(folders, 0);
+	});
+
+	ScanCache cache(workDir.path() + "/bench.cache");
+	scanFolders(folders, &cache);
+	results.measure("scan.cached", iterations, [&]() {
+		scanFolders(folders, &cache);
+	});
+
+	results.measure("conflicts.build", iterations, [&]() {
+		ConflictIndex index;
+		foreach (const QString& folder, folders)
+			index.addFolder(folder, scanned.value(folder));
+		index.setLoadOrder(folders);
+	});
+
+	// Archives, written with BsaArchive::create and then read back.
+	QStringList archiveNames = generateArchives(folders, scanned, archiveCount);
+	if (archiveNames.size() != std::min(archiveCount, folders.size()))
+	{
+		qCritical("Couldn't write the generated archives.");
+		return 1;
+	}
+	results.measure("archive.list", iterations, [&]() {
+		for (int i = 0; i < archiveNames.size(); i++)
+		{
+			BsaArchive archive(folders[i] + "/" + archiveNames[i]);
+			if (archive.open())
+				archive.fileNames();
+		}
+	});
+
+	// The whole model, loaded from a generated config folder.
+	writeConfigFolder(configFolder, folders, archiveNames);
+	{
+		SettingsInterface settings(configFolder + "/mods.json");
+		OpenMWConfigInterface config(configFolder + "/openmw.cfg");
+		settings.setReadOnly(true);
+		config.setReadOnly(true);
+
+		QElapsedTimer loadTimer;
+		loadTimer.start();
+		TreeModModel model(&settings, &config);
+		waitForScanner(model.getScanner());
+		QVector<double> loadSamples;
+		loadSamples.push_back(loadTimer.nsecsElapsed() / 1000000.0);
+		results.add("model.load_and_scan", loadSamples);
+
+		if (!checkArchives(model, folders, scanned, archiveNames))
+		{
+			qCritical("Archive contents don't show up in the conflict index as expected.");
+			return 1;
+		}
+
+		// Selecting the row that is already selected returns straight away, so every sample picks another one.
+		std::mt19937 random(shape.seed);
+		std::uniform_int_distribution<int> otherRow(0, std::max(0, model.rowCount() - 2));
+		QVector<double> selectionSamples;
+		int previousRow = -1;
+		for (int i = 0; i < iterations * 20; i++)
+		{
+			int selectedRow = otherRow(random);
+			if (previousRow >= 0 && selectedRow >= previousRow)
+				selectedRow++;
+			if (selectedRow >= model.rowCount())
+			{
+				selectedRow = 0;
+				model.updateConflictSelection(QItemSelection(), QItemSelection());
+			}
+			previousRow = selectedRow;
+			QItemSelection selection(model.index(selectedRow, 0), model.index(selectedRow, TreeModItem::COLUMN_COUNT - 1));
+
+			QElapsedTimer timer;
+			timer.start();
+			model.updateConflictSelection(selection, QItemSelection());
+			selectionSamples.push_back(timer.nsecsElapsed() / 1000000.0);
+		}
+		results.add("model.update_conflict_selection", selectionSamples);
+
+		results.measure("model.get_index_for_folder", iterations, [&]() {
+			foreach (const QString& folder, folders)
+				model.getIndexForFolder(folder);
+		});
+	}
+
+	// Config files on their own.
+	OpenMWConfigInterface config(configFolder + "/openmw.cfg");
+	results.measure("config.load", iterations, [&]() {
+		config.load();
+	});
+	results.measure("config.save", iterations, [&]() {
+		// Saving only writes when something changed, so change the data= block every time.
+		QVector<QVariant>& dataFolders = config.getByKey("data");
+		if (dataFolders.size() == folders.size())
+			dataFolders.pop_back();
+		else
+			dataFolders.push_back(folders.last());
+		config.save();
+	});
+
+	results.measure("settings.round_trip", iterations, [&]() {
+		SettingsInterface settings(configFolder + "/mods.json");
+		settings.save();
+	});
+
+	// Loading the tree from mods.json, then from the mods.bin that gets written next to it.
+	QFile::remove(configFolder + "/mods.bin");
+	auto loadModel = [&]() {
+		SettingsInterface settings(configFolder + "/mods.json");
+		OpenMWConfigInterface config(configFolder + "/openmw.cfg");
+		settings.setReadOnly(true);
+		config.setReadOnly(true);
+		TreeModModel model(&settings, &config);
+	};
+	results.measure("model.load_json", iterations, loadModel);
+	{
+		SettingsInterface settings(configFolder + "/mods.json");
+		OpenMWConfigInterface config(configFolder + "/openmw.cfg");
+		config.setReadOnly(true);
+		TreeModModel model(&settings, &config);
+	}
+	results.measure("model.load_binary", iterations, loadModel);
+
+	QJsonObject parameters;
+	parameters["mods"] = shape.mods;
+	parameters["files"] = shape.mods * shape.filesPerMod;
+	parameters["overlap"] = shape.overlap;
+	parameters["directories"] = shape.directories;
+	parameters["archives"] = archiveNames.size();
+	parameters["iterations"] = iterations;
+	parameters["seed"] = int(shape.seed);
+
+	QJsonObject report;
+	report["parameters"] = parameters;
+	report["results"] = results.toJson();
+	QByteArray json = QJsonDocument(report).toJson();
+
+	if (parser.isSet(outputOption))
+	{
+		QFile output(parser.value(outputOption));
+		if (!output.open(QIODevice::WriteOnly))
+		{
+			qCritical("Couldn't open the output file for writing.");
+			return 1;
+		}
+		output.write(json);
+	}
+	else
+	{
+		QTextStream(stdout) << json;
+	}
+
+	return 0;
+}
@@ -1,11 +1,107 @@
 #include "WinMain.h"
+#include "HeadlessRunner.h"
+#include "Trace.h"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QDir>
+
+// Both the window and headless runs can be traced.
+static QCommandLineOption makeTraceOption()
+{
+	return QCommandLineOption("trace", "Write a Chrome trace of the run to <file>.", "file");
+}
+
+static int runHeadless(int argc, char *argv[])
+{
+	QCoreApplication a(argc, argv);
+	QCoreApplication::setApplicationName("OpenMW-MM");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Checks a mod list for conflicts without opening a window.");
+	parser.addHelpOption();
+	QCommandLineOption headlessOption("headless", "Check the mod list without opening a window.");
+	QCommandLineOption configOption(QStringList() << "c" << "config", "Folder containing openmw.cfg and mods.json.", "folder");
+	QCommandLineOption reportOption(QStringList() << "r" << "report", "Write a file conflict report to <file>, or - for standard output.", "file");
+	QCommandLineOption overlapsOption(QStringList() << "o" << "overlaps", "Write every pair of overlapping folders as CSV to <file>, or - for standard output.", "file");
+	QCommandLineOption printDataOption(QStringList() << "d" << "print-data", "Print the data= lines generated from mods.json.");
+	QCommandLineOption writeConfigOption(QStringList() << "w" << "write-config", "Write the generated data= lines back into openmw.cfg.");
+	QCommandLineOption hideIdenticalOption("hide-identical", "Hash conflicting files and leave byte-identical copies out of the report.");
+	QCommandLineOption traceOption = makeTraceOption();
+	parser.addOption(headlessOption);
+	parser.addOption(configOption);
+	parser.addOption(reportOption);
+	parser.addOption(overlapsOption);
+	parser.addOption(printDataOption);
+	parser.addOption(writeConfigOption);
+	parser.addOption(hideIdenticalOption);
+	parser.addOption(traceOption);
+	parser.process(a);
+
+	if (parser.isSet(traceOption))
+		Trace::enable(parser.value(traceOption));
+
+	QString configFolder = parser.isSet(configOption) ? parser.value(configOption) : OpenMWConfigInterface::defaultConfigFolder();
+	QDir configDir(configFolder);
+	if (configFolder.isEmpty() || !configDir.exists("openmw.cfg") || !configDir.exists("mods.json"))
+	{
+		qCritical("Couldn't find openmw.cfg and mods.json; pass their folder with --config.");
+		return 2;
+	}
+
+	int result;
+	{
+		HeadlessRunner runner(configDir.absolutePath());
+		runner.setReportPath(parser.value(reportOption));
+		runner.setOverlapsPath(parser.value(overlapsOption));
+		runner.setPrintData(parser.isSet(printDataOption));
+		runner.setWriteConfig(parser.isSet(writeConfigOption));
+		runner.setHideIdentical(parser.isSet(hideIdenticalOption));
+		runner.start();
+		result = a.exec();
+	}
+
+	Trace::flush();
+	return result;
+}
+
+//! Looked for before any application object exists, since that decides which one to create.
+static bool isHeadless(int argc, char *argv[])
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (qstrcmp(argv[i], "--headless") == 0)
+			return true;
+	}
+	return false;
+}
 
 int main(int argc, char *argv[])
 {
+	// Set OPENMWMM_TRACE to a file name to record where the time goes.
+	Trace::enableFromEnvironment();
+
+	// Scripts ask for --headless; don't create a single widget then. Everything else, like -style, is Qt's.
+	if (isHeadless(argc, argv))
+		return runHeadless(argc, argv);
+
 	QApplication a(argc, argv);
-	WinMain w;
-	w.show();
 
-	return a.exec();
+	// The window has no options but --trace. Qt takes its own out of the arguments; anything else is ignored.
+	QCommandLineParser parser;
+	QCommandLineOption traceOption = makeTraceOption();
+	parser.addOption(traceOption);
+	parser.parse(a.arguments());
+	if (parser.isSet(traceOption))
+		Trace::enable(parser.value(traceOption));
+
+	int result;
+	{
+		WinMain w;
+		w.show();
+		result = a.exec();
+	}
+
+	// After the window is gone, so that the final saves are in the trace too.
+	Trace::flush();
+	return result;
 }
@@ -0,0 +1,276 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QMap>
+#include <QMimeData>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+#include <algorithm>
+
+#include "OpenMWConfigInterface.h"
+#include "SettingsInterface.h"
+#include "TreeModModel.h"
+
+static const char* DATA_PLACEHOLDER = "$DATA";
+
+typedef QMap<QString, QVector<double> > LatencyMap;
+
+static QTextStream& err()
+{
+	static QTextStream stream(stderr);
+	return stream;
+}
+
+static QByteArray readFile(const QString& path)
+{
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly))
+		return QByteArray();
+	return file.readAll();
+}
+
+static bool writeFile(const QString& path, const QByteArray& contents)
+{
+	QFile file(path);
+	if (!file.open(QIODevice::WriteOnly))
+		return false;
+	return file.write(contents) == contents.size();
+}
+
+//! Turns a row path like "3/0" into an index. "-" is the top level.
+static QModelIndex resolveRow(QAbstractItemModel* model, const QString& rowPath, int column = 0)
+{
+	QModelIndex index;
+	if (rowPath == "-")
+		return index;
+
+	foreach (const QString& row, rowPath.split('/'))
+		index = model->index(row.toInt(), column, index.sibling(index.row(), 0));
+	return index;
+}
+
+static void waitForScanner(TreeModModel* model)
+{
+	FolderScanner* scanner = model->getScanner();
+	if (!scanner->isIdle())
+	{
+		QEventLoop loop;
+		QObject::connect(scanner, SIGNAL(finished()), &loop, SLOT(quit()));
+		loop.exec();
+	}
+	QCoreApplication::processEvents();
+}
+
+//! Drags a row within the tree. The model moves it itself, just as it does for the view.
+static bool moveRow(TreeModModel* model, const QModelIndex& source, const QModelIndex& parent, int row)
+{
+	QMimeData* data = model->mimeData(QModelIndexList() << source);
+	bool moved = model->dropMimeData(data, Qt::MoveAction, row, 0, parent);
+	delete data;
+	return moved;
+}
+
+static bool applyOperation(TreeModModel* model, const QString& operation, const QString& arguments, const QString& dataFolder)
+{
+	QString expanded = QString(arguments).replace(DATA_PLACEHOLDER, dataFolder);
+	QString target = expanded.section(' ', 0, 0);
+	QString rest = expanded.section(' ', 1);
+
+	if (operation == "wait")
+	{
+		waitForScanner(model);
+		return true;
+	}
+	if (operation == "select")
+	{
+		QModelIndex index = resolveRow(model, target);
+		QItemSelection selection(index, index.sibling(index.row(), TreeModItem::COLUMN_COUNT - 1));
+		model->updateConflictSelection(selection, QItemSelection());
+		return index.isValid();
+	}
+	if (operation == "toggle")
+	{
+		QModelIndex index = resolveRow(model, target, TreeModItem::COLUMN_ENABLED);
+		return model->setData(index, rest.toInt() ? Qt::Checked : Qt::Unchecked, Qt::CheckStateRole);
+	}
+	if (operation == "rename")
+		return model->setData(resolveRow(model, target, TreeModItem::COLUMN_NAME), rest);
+	if (operation == "folder")
+		return model->setData(resolveRow(model, target, TreeModItem::COLUMN_FOLDER), rest);
+	if (operation == "remove")
+	{
+		QModelIndex index = resolveRow(model, target);
+		return model->removeRow(index.row(), index.parent());
+	}
+	if (operation == "insert")
+	{
+		// insert <parent> <row> <name>|<folder>|<enabled>
+		QModelIndex parent = resolveRow(model, target);
+		int row = rest.section(' ', 0, 0).toInt();
+		QStringList columns = rest.section(' ', 1).split('|');
+		if (columns.size() != 3)
+			return false;
+
+		// The same path adding data from the window takes.
+		TreeModItem items;
+		items.appendChild(columns[0], columns[1], columns[2].toInt() != 0);
+		return model->insertItems(row, &items, parent);
+	}
+	if (operation == "move")
+	{
+		// move <source> <parent> <row>
+		QModelIndex source = resolveRow(model, target);
+		QModelIndex parent = resolveRow(model, rest.section(' ', 0, 0));
+		return moveRow(model, source, parent, rest.section(' ', 1, 1).toInt());
+	}
+
+	err() << "Unknown operation '" << operation << "'\n";
+	return false;
+}
+
+//! Replays the trace once, from a fresh copy of the fixture's config files.
+static bool replay(const QString& fixture, const QString& dataFolder, LatencyMap& latencies, QByteArray& modsJson, QByteArray& openMWCfg)
+{
+	QTemporaryDir configDir;
+	if (!configDir.isValid())
+		return false;
+
+	QString configFolder = configDir.path();
+	writeFile(configFolder + "/mods.json", readFile(fixture + "/mods.json").replace(DATA_PLACEHOLDER, dataFolder.toUtf8()));
+	writeFile(configFolder + "/openmw.cfg", readFile(fixture + "/openmw.cfg").replace(DATA_PLACEHOLDER, dataFolder.toUtf8()));
+
+	QFile traceFile(fixture + "/trace.txt");
+	if (!traceFile.open(QIODevice::ReadOnly | QIODevice::Text))
+	{
+		err() << "Couldn't open " << traceFile.fileName() << "\n";
+		return false;
+	}
+
+	bool success = true;
+	{
+		SettingsInterface settings(configFolder + "/mods.json");
+		OpenMWConfigInterface config(configFolder + "/openmw.cfg");
+
+		QElapsedTimer loadTimer;
+		loadTimer.start();
+		TreeModModel* model = new TreeModModel(&settings, &config);
+		latencies["load"].push_back(loadTimer.nsecsElapsed() / 1000000.0);
+
+		QTextStream trace(&traceFile);
+		int lineNumber = 0;
+		while (!trace.atEnd())
+		{
+			QString line = trace.readLine().trimmed();
+			lineNumber++;
+			if (line.isEmpty() || line.startsWith('#'))
+				continue;
+
+			QString operation = line.section(' ', 0, 0);
+			QElapsedTimer timer;
+			timer.start();
+			bool applied = applyOperation(model, operation, line.section(' ', 1), dataFolder);
+			latencies[operation].push_back(timer.nsecsElapsed() / 1000000.0);
+
+			if (!applied)
+			{
+				err() << "trace.txt:" << lineNumber << ": '" << line << "' failed\n";
+				success = false;
+			}
+		}
+
+		// Everything is written out when the model and the interfaces go away.
+		waitForScanner(model);
+		delete model;
+	}
+
+	modsJson = readFile(configFolder + "/mods.json").replace(dataFolder.toUtf8(), DATA_PLACEHOLDER);
+	openMWCfg = readFile(configFolder + "/openmw.cfg").replace(dataFolder.toUtf8(), DATA_PLACEHOLDER);
+	return success;
+}
+
+static double percentile(const QVector<double>& sorted, double fraction)
+{
+	int index = qBound(0, int(fraction * (sorted.size() - 1) + 0.5), sorted.size() - 1);
+	return sorted[index];
+}
+
+static void printLatencies(const LatencyMap& latencies)
+{
+	QTextStream out(stdout);
+	out << qSetFieldWidth(12) << left << "operation" << qSetFieldWidth(10) << right << "count" << "p50 ms" << "p90 ms" << "p99 ms" << "max ms" << qSetFieldWidth(0) << "\n";
+	for (LatencyMap::const_iterator it = latencies.constBegin(); it != latencies.constEnd(); ++it)
+	{
+		QVector<double> sorted = it.value();
+		std::sort(sorted.begin(), sorted.end());
+		out << qSetFieldWidth(12) << left << it.key() << qSetFieldWidth(10) << right << sorted.size()
+			<< QString::number(percentile(sorted, 0.5), 'f', 3)
+			<< QString::number(percentile(sorted, 0.9), 'f', 3)
+			<< QString::number(percentile(sorted, 0.99), 'f', 3)
+			<< QString::number(sorted.last(), 'f', 3) << qSetFieldWidth(0) << "\n";
+	}
+}
+
+static bool checkOutput(const QString& expectedPath, const QByteArray& actual, bool update)
+{
+	if (update)
+		return writeFile(expectedPath, actual);
+
+	QFile expected(expectedPath);
+	if (!expected.exists())
+	{
+		err() << expectedPath << " is missing; run with --update to create it.\n";
+		return false;
+	}
+
+	if (readFile(expectedPath) != actual)
+	{
+		err() << "Output differs from " << expectedPath << ":\n" << actual;
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication a(argc, argv);
+	QCoreApplication::setApplicationName("OpenMW-MM-replay");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Replays a trace of model operations against a fixture, reports latencies and checks the saved mods.json and openmw.cfg.");
+	parser.addHelpOption();
+	parser.addPositionalArgument("fixture", "Fixture folder holding mods.json, openmw.cfg, trace.txt, data/ and expected/.");
+	QCommandLineOption iterationsOption("iterations", "Number of times to replay the trace.", "count", "1");
+	QCommandLineOption updateOption("update", "Overwrite the expected output with this run's output.");
+	parser.addOption(iterationsOption);
+	parser.addOption(updateOption);
+	parser.process(a);
+
+	if (parser.positionalArguments().size() != 1)
+		parser.showHelp(2);
+
+	QString fixture = QDir(parser.positionalArguments().first()).absolutePath();
+	QString dataFolder = QDir(fixture + "/data").absolutePath();
+	int iterations = std::max(1, parser.value(iterationsOption).toInt());
+	bool update = parser.isSet(updateOption);
+
+	LatencyMap latencies;
+	bool success = true;
+	for (int i = 0; i < iterations; i++)
+	{
+		QByteArray modsJson;
+		QByteArray openMWCfg;
+		success &= replay(fixture, dataFolder, latencies, modsJson, openMWCfg);
+
+		// Every iteration has to produce the same files, not just the first.
+		success &= checkOutput(fixture + "/expected/mods.json", modsJson, update);
+		success &= checkOutput(fixture + "/expected/openmw.cfg", openMWCfg, update);
+		update = false;
+	}
+
+	printLatencies(latencies);
+	return success ? 0 : 1;
+}
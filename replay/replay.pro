@@ -0,0 +1,16 @@
+#-------------------------------------------------
+#
+# Replays recorded model operations against fixtures and checks the saved files.
+#
+#-------------------------------------------------
+
+QT       += core gui concurrent widgets
+
+TARGET = OpenMW-MM-replay
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+include(../OpenMW-MM.pri)
+
+SOURCES += main.cpp